@@ -0,0 +1,21 @@
+#include <stdio.h>
+#include <stdint.h>
+
+static uint64_t acc = 0;
+
+void fib(int n)
+{
+    if (n < 2) {
+        acc += n;
+        return;
+    }
+    fib(n - 1);
+    fib(n - 2);
+}
+
+int main(void)
+{
+    fib(35);
+    printf("%lu\n", acc);
+    return 0;
+}
@@ -0,0 +1,11 @@
+#include <stdio.h>
+#include <stdint.h>
+
+int main(void)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i != 300000000; i++)
+        sum += (i * i) ^ (sum >> 3);
+    printf("%lu\n", sum);
+    return 0;
+}
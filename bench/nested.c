@@ -0,0 +1,15 @@
+#include <stdio.h>
+#include <stdint.h>
+
+int main(void)
+{
+    uint64_t acc = 0;
+    for (int rep = 0; rep != 300; rep++) {
+        for (int i = 0; i <= 1000; i++) {
+            for (int j = 0; j <= 1000; j++)
+                acc += (i ^ j) + rep;
+        }
+    }
+    printf("%lu\n", acc);
+    return 0;
+}
@@ -0,0 +1,17 @@
+/* Types the generated C expects to exist, the compiler does not emit them yet */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef int8_t i8;
+typedef uint8_t u8;
+typedef int16_t i16;
+typedef uint16_t u16;
+typedef int32_t i32;
+typedef uint32_t u32;
+typedef int64_t i64;
+typedef uint64_t u64;
+typedef float f32;
+typedef double f64;
+typedef intptr_t isize;
+typedef size_t usize;
@@ -0,0 +1,93 @@
+#!/bin/sh
+# Runtime benchmarks: every <name>.tzn is compiled with Tanzanite, its twin
+# <name>.c is compiled directly, both are run REPS times and the best wall
+# time of each is compared.
+#
+# usage: bench/run.sh [path/to/Tanzanite] [name...]
+#   CC      C compiler used for both sides (default: cc)
+#   CFLAGS  flags used for both sides (default: -O2)
+#   REPS    runs per binary, the fastest one is reported (default: 5)
+
+set -e
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+TANZANITE=${1:-./Tanzanite}
+[ $# -gt 0 ] && shift
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+REPS=${REPS:-5}
+
+if [ ! -x "$TANZANITE" ]; then
+    echo "run.sh: compiler '$TANZANITE' not found, build it first" >&2
+    exit 1
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if [ $# -gt 0 ]; then
+    NAMES="$*"
+else
+    NAMES=$(cd "$BENCH_DIR" && ls *.tzn | sed 's/\.tzn$//')
+fi
+
+now_ns() {
+    date +%s%N
+}
+
+# best_of <binary> -> fastest run in nanoseconds, output kept in <binary>.out
+best_of() {
+    best=
+    i=0
+    while [ $i -lt "$REPS" ]; do
+        start=$(now_ns)
+        "$1" > "$1.out"
+        end=$(now_ns)
+        t=$((end - start))
+        if [ -z "$best" ] || [ $t -lt $best ]; then
+            best=$t
+        fi
+        i=$((i + 1))
+    done
+    echo $best
+}
+
+ms() {
+    awk -v ns="$1" 'BEGIN { printf "%.2f", ns / 1000000 }'
+}
+
+printf '%-12s %12s %12s %8s\n' "bench" "tanzanite ms" "c ms" "ratio"
+
+status=0
+for name in $NAMES; do
+    tz_src="$BENCH_DIR/$name.tzn"
+    c_src="$BENCH_DIR/$name.c"
+
+    if ! "$TANZANITE" < "$tz_src" > "$WORK/$name.gen.c" 2> "$WORK/$name.tz.log"; then
+        echo "$name: Tanzanite failed, see below" >&2
+        cat "$WORK/$name.tz.log" >&2
+        status=1
+        continue
+    fi
+
+    if ! $CC $CFLAGS -w -include "$BENCH_DIR/prelude.h" -o "$WORK/$name.tz" "$WORK/$name.gen.c"; then
+        echo "$name: generated C does not compile" >&2
+        status=1
+        continue
+    fi
+    $CC $CFLAGS -o "$WORK/$name.c" "$c_src"
+
+    tz_ns=$(best_of "$WORK/$name.tz")
+    c_ns=$(best_of "$WORK/$name.c")
+
+    if ! cmp -s "$WORK/$name.tz.out" "$WORK/$name.c.out"; then
+        echo "$name: output differs from the C version" >&2
+        status=1
+    fi
+
+    ratio=$(awk -v a="$tz_ns" -v b="$c_ns" 'BEGIN { printf "%.2f", a / b }')
+    printf '%-12s %12s %12s %7sx\n' "$name" "$(ms $tz_ns)" "$(ms $c_ns)" "$ratio"
+done
+
+exit $status
@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+int main(void)
+{
+    int64_t limit = 50000000;
+    uint8_t *marks = calloc(limit + 1, 1);
+    int64_t count = 0;
+
+    for (int64_t i = 2; i <= limit; i++) {
+        if (marks[i] != 0)
+            continue;
+        count++;
+        for (int64_t j = i * i; j <= limit; j += i)
+            marks[j] = 1;
+    }
+
+    free(marks);
+    printf("%ld\n", count);
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(void)
+{
+    int64_t size = 1000000;
+    char *buf = calloc(size + 1, 1);
+    memset(buf, 'x', size);
+    for (int64_t i = 0; i < size; i += 61)
+        buf[i] = 'a';
+
+    int64_t hits = 0;
+    for (int round = 0; round != 1000; round++) {
+        for (char *p = strchr(buf, 'a'); p != NULL; p = strchr(p + 1, 'a'))
+            hits++;
+        hits += strlen(buf);
+    }
+
+    free(buf);
+    printf("%ld\n", hits);
+    return 0;
+}
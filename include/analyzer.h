@@ -6,4 +6,13 @@
 #include <analyzer/context.h>
 
 struct ast *prepare(struct analyzer_context *ctx, struct ast *to_process);
+
+/* pieces of prepare(), for drivers that analyze one function at a time */
+void prepare_globals(struct analyzer_context *ctx, struct ast *to_process);
+void prepare_function(struct analyzer_context *ctx, const char *name);
+
+/* empties ctx for the next program and keeps the room its stores grew to, bodies are freed unless told otherwise */
+void clear_context(struct analyzer_context *ctx, bool bodies);
+/* gives the room of a cleared ctx back */
+void free_context(struct analyzer_context *ctx);
 #endif
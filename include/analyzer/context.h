@@ -1,10 +1,13 @@
 #ifndef __ANALYZER_CONTEXT_H__
 #define __ANALYZER_CONTEXT_H__
 
+#include <analyzer/function.h>
 #include <hash/type_store.h>
 #include <hash/var_store.h>
 #include <hash/function_store.h>
 #include <queue/function_call_queue.h>
+#include <queue/global_read_queue.h>
+#include <stack/ast_stack.h>
 
 struct analyzer_context {
     struct type_store types;
@@ -12,6 +15,22 @@ struct analyzer_context {
     struct function_store functions;
 
     struct fn_call_queue call_queue;
+
+    /* every function is an entry point besides main, and main is optional */
+    bool module;
+    /* bench blocks become functions the harness runs, main is then optional, without it they are dropped */
+    bool bench;
+    size_t benches;
+
+    /* names looked up in the global frame, only while record_globals is set */
+    struct global_read_queue global_reads;
+    bool record_globals;
+
+    /* what the function being checked does, lowered as its body is analyzed */
+    enum fn_effect effect;
+
+    /* the walk of operation trees, kept so a check that fails halfway doesn't lose it */
+    struct ast_stack operations;
 };
 
 #endif
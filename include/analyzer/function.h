@@ -9,6 +9,26 @@
 
 struct ast;
 
+/* what @[...] asks of a function, passed on to the C compiler as attributes but for export */
+enum fn_attribute {
+    FN_INLINE = 1 << 0,
+    FN_NOINLINE = 1 << 1,
+    FN_HOT = 1 << 2,
+    FN_COLD = 1 << 3,
+    /* part of the module's interface, external to the generated C */
+    FN_EXPORT = 1 << 4,
+};
+
+/* what calling a function can observe or change, ordered from the least to the most it promises */
+enum fn_effect {
+    /* writes globals, calls code that isn't known or might never return */
+    FN_IMPURE,
+    /* reads globals or memory through pointers, but changes nothing */
+    FN_PURE,
+    /* its result depends on its arguments only */
+    FN_CONST,
+};
+
 struct analyzable_function {
     struct analyzable_type return_type;
     struct str name;
@@ -23,6 +43,16 @@ struct analyzable_function {
     bool variadic; 
     /* the analyzer has checked the function */
     bool checked;
+    /* called from outside the generated C, main or an @[export] function */
+    bool exported;
+    /* enum fn_attribute flags */
+    unsigned attributes;
+    /* nodes in the analyzed body, what inlining it would copy into every caller */
+    size_t cost;
+    /* the body alone until prepare() has looked at what it calls */
+    enum fn_effect effect;
+    /* the name of the bench block the function was made from, NULL for the others */
+    struct str bench;
 };
 
 struct analyzable_fn_arg {
@@ -33,6 +63,8 @@ struct analyzable_fn_arg {
 
 struct analyzable_call_arg {
     struct ast *value;
+    /* value is the default from the function signature and is shared with it */
+    bool default_value;
 };
 
 struct analyzable_call {
@@ -40,6 +72,8 @@ struct analyzable_call {
     struct str identifier;
     struct analyzable_call_arg *args;
     size_t args_count;
+    /* calls the function it is in as the last thing that function does, it becomes a jump */
+    bool tail;
 };
 
 #endif
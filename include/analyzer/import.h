@@ -0,0 +1,16 @@
+#ifndef __ANALYZER_IMPORT_H__
+#define __ANALYZER_IMPORT_H__
+
+#include <str.h>
+#include <stddef.h>
+
+#include <analyzer/function.h>
+
+struct analyzable_import {
+    struct str module;
+    /* copies of the signatures the import added, codegen emits prototypes for them */
+    struct analyzable_function *functions;
+    size_t functions_count;
+};
+
+#endif
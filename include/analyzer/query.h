@@ -0,0 +1,35 @@
+#ifndef __ANALYZER_QUERY_H__
+#define __ANALYZER_QUERY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <str.h>
+
+#include <cache.h>
+
+enum query_kind {
+    QUERY_SIGNATURE = 's',
+    QUERY_GLOBAL = 'g',
+};
+
+/* an input a checked body was computed from, with its value at the time */
+struct query_dep {
+    enum query_kind kind;
+    char *name;
+    char fingerprint[CACHE_KEY_SIZE];
+};
+
+/* the checked and emitted body of one function */
+struct query_result {
+    char body[CACHE_KEY_SIZE];
+    bool reused;
+    struct str code;
+    struct query_dep *deps;
+    size_t deps_count;
+};
+
+struct fingerprint {
+    char hex[CACHE_KEY_SIZE];
+};
+
+#endif
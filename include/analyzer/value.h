@@ -10,4 +10,10 @@ struct analyzable_value {
     struct ast *value;
 };
 
+/* C emitted by the module an imported default value comes from */
+struct analyzable_emitted {
+    struct analyzable_type result;
+    struct str code;
+};
+
 #endif
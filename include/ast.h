@@ -12,6 +12,7 @@
 #include <analyzer/loops.h>
 #include <analyzer/operation.h>
 #include <analyzer/conditions.h>
+#include <analyzer/import.h>
 
 enum node_type {
     /* Parser nodes */
@@ -50,6 +51,9 @@ enum node_type {
     BREAK,
     VARIADIC,
     RANGE,
+    LAZY_BODY,
+    IMPORT,
+    BENCH,
 
     /* Analysis special nodes */
     ANALYZE_VALUE = 256,
@@ -61,10 +65,28 @@ enum node_type {
     ANALYZE_FOR,
     ANALYZE_WHILE,
     ANALYZE_TYPE_CAST,
+    ANALYZE_IMPORT,
+    ANALYZE_EMITTED,
+};
+
+/* byte range of the input that has not been parsed yet */
+struct source_range {
+    uint64_t offset;
+    uint64_t length;
+    int line;
+};
+
+/* where a statement starts and ends, lines are 0 for nodes the parser didn't place */
+struct source_span {
+    int line;
+    int column;
+    int end_line;
+    int end_column;
 };
 
 struct ast {
     enum node_type type;
+    struct source_span span;
     union {
         struct ast *program;
         struct {
@@ -110,6 +132,7 @@ struct ast {
             struct ast *ident;
             struct ast *arg_list;
             bool immutable;
+            unsigned attributes;
         } function_declaration;
         struct {
             struct ast *return_type;
@@ -117,6 +140,7 @@ struct ast {
             struct ast *arg_list;
             struct ast *body;
             bool immutable;
+            unsigned attributes;
         } function_definition;
         struct {
             struct ast *current;
@@ -178,6 +202,12 @@ struct ast {
             int64_t start;
             int64_t end;
         } range;
+        struct source_range lazy_body;
+        struct str import;
+        struct {
+            struct str name;
+            struct ast *body;
+        } bench;
 
         /* Analysis special nodes */
         struct analyzable_value a_value;
@@ -189,10 +219,23 @@ struct ast {
         struct analyzable_for a_for;
         struct analyzable_while a_while;
         struct analyzable_cast a_cast;
+        struct analyzable_import a_import;
+        struct analyzable_emitted a_emitted;
     } u;
 };
 
-struct ast *parse();
+/* head and tail of a list being built by the parser, appends are O(1) */
+struct ast_list {
+    struct ast *head;
+    struct ast *tail;
+};
+
+struct ast *parse(unsigned jobs);
+struct ast *parse_buffer(struct str buffer, unsigned jobs);
+struct ast *parse_chunk(struct source_range range);
+struct str parse_source(void);
+void parse_use_source(struct str buffer);
+void parse_lazy_body(struct ast *node);
 
 struct ast *program_node(struct ast *statement);
 struct ast *statement_node(struct ast *list, struct ast *statement);
@@ -229,9 +272,51 @@ struct ast *break_node();
 struct ast *next_node();
 struct ast *variadic_node();
 struct ast *range_node(int64_t start, int64_t end);
+struct ast *lazy_body_node(struct source_range range);
+struct ast *import_node(struct str module);
+struct ast *bench_node(struct str name, struct ast *body);
+/* the enum fn_attribute named by an annotation, 0 when there is none */
+unsigned fn_attribute(const char *name);
+struct ast *annotate_fn_node(struct ast *fn, unsigned attributes);
+
+struct ast_list statement_list_append(struct ast_list list, struct ast *statement);
+struct ast_list identifier_chain_append(struct ast_list list, struct ast *ident);
+struct ast_list fn_arg_list_append(struct ast_list list, struct ast *arg);
 
 struct ast *dup_node(struct ast *node);
+void free_node(struct ast *node);
+/* frees the node alone, what it points to was moved elsewhere */
+void free_node_shell(struct ast *node);
+size_t count_nodes(struct ast *node);
+void walk_nodes(struct ast *node, void (*visit)(struct ast *node, void *data), void *data);
 
 void describe(struct ast *node);
 
+/*
+ * What trees own, their nodes and the strings and arrays the nodes point to,
+ * made and not yet freed while a tracker is in use. A compilation that fails
+ * halfway frees all of it, a finished one what its tree no longer points to.
+ * Anything allocated with ast_alloc or ast_str has to be freed with ast_free
+ * or ast_str_free. Tracking is global, trees built on other threads at the
+ * same time must not be.
+ */
+struct ast_tracker {
+    void **slots;
+    size_t cap;
+    size_t len;
+};
+
+/* NULL stops tracking */
+void ast_track(struct ast_tracker *tracker);
+/* frees every block still tracked and keeps the room for the next compilation */
+void ast_tracker_clear(struct ast_tracker *tracker);
+void ast_tracker_free(struct ast_tracker *tracker);
+
+/* zeroed like calloc */
+void *ast_alloc(size_t count, size_t size);
+void ast_free(void *block);
+/* a copy of a string for the tree, like str_init */
+struct str ast_str(const char *s, uint64_t len);
+void ast_str_free(struct str *s);
+
 #endif
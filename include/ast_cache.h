@@ -0,0 +1,19 @@
+#ifndef __AST_CACHE_H__
+#define __AST_CACHE_H__
+
+#include <stdbool.h>
+#include <ast.h>
+#include <str.h>
+
+/*
+ * Binary copy of a parsed tree, loaded instead of lexing and parsing the
+ * source again. Trees with lazy bodies carry the source they point into.
+ */
+bool ast_write(struct ast *program, const char *path);
+/* NULL if path doesn't exist or doesn't hold a tree this compiler wrote */
+struct ast *ast_read(const char *path);
+
+/* where the tree of source is kept in a cache directory */
+struct str ast_cache_path(const char *dir, struct str source);
+
+#endif
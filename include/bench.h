@@ -0,0 +1,16 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+/*
+ * C that --bench adds to the program. Every bench block becomes a function
+ * run in batches until a batch takes long enough to time, after warming up,
+ * and the median and 99th percentile time of a run and the runs per second
+ * are printed for each. The program's main is renamed, the harness replaces it.
+ */
+
+/* tz_bench_keep and struct tz_bench, before the program */
+extern const char bench_runtime[];
+/* the harness main, after tz_benches, a table of struct tz_bench ending with {0, 0} */
+extern const char bench_main[];
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <str.h>
+#include <sha256.h>
+
+#define CACHE_KEY_SIZE (SHA256_DIGEST_SIZE * 2 + 1)
+
+/* generated C kept on disk, keyed by a hash of everything it depends on */
+struct cache {
+    char key[CACHE_KEY_SIZE];
+    struct str path;
+    struct str tmp_path;
+};
+
+void cache_key(char key[CACHE_KEY_SIZE], const char *options, const void *data, size_t size);
+bool cache_init(struct cache *cache, const char *dir, const char *options, struct str source);
+bool cache_fetch(struct cache *cache, FILE *out);
+FILE *cache_create(struct cache *cache);
+void cache_commit(struct cache *cache, FILE *entry, FILE *out);
+void cache_deinit(struct cache *cache);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __CALL_GRAPH_H__
+#define __CALL_GRAPH_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <ast.h>
+#include <hash/function_index.h>
+
+/* a function of the program that has an analyzed body */
+struct call_graph_node {
+    /* the ANALYZE_FN statement */
+    struct ast *fn;
+    /* indexes of the functions it calls and that call it, each once */
+    size_t *callees;
+    size_t callees_count;
+    size_t *callers;
+    size_t callers_count;
+    /* calls to declared or imported functions, whose bodies aren't known */
+    size_t external_calls;
+};
+
+struct call_graph {
+    /* in source order */
+    struct call_graph_node *nodes;
+    size_t count;
+    struct function_index index;
+};
+
+void call_graph_build(struct call_graph *g, struct ast *program);
+/* the index of a function, count when it has no body here */
+size_t call_graph_find(struct call_graph *g, const char *name);
+/* every index once, callees before their callers unless they call each other */
+size_t *call_graph_order(struct call_graph *g);
+/* for every index, whether the function can call itself again, directly or through others */
+bool *call_graph_recursive(struct call_graph *g);
+void call_graph_free(struct call_graph *g);
+
+#endif
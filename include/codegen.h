@@ -4,6 +4,27 @@
 #include <ast.h>
 #include <str.h>
 
+struct profile;
+
+/* count calls, branches taken and loop rounds, the program writes them out when it exits */
+extern bool codegen_instrument;
+/* what an instrumented run counted, for branch hints, hot and cold functions and their order */
+extern struct profile *codegen_profile;
+/* wrap every function in calls that record when it starts and ends, see trace.h */
+extern bool codegen_trace;
+/* add the harness that runs the bench functions in place of main, see bench.h */
+extern bool codegen_bench;
+/* the file #line directives name, statements say where they were written unless it's NULL */
+extern const char *codegen_source_name;
+/* what #line directives name for the C that follows the program, the runtimes of the options */
+#define CODEGEN_RUNTIME_NAME "<tanzanite runtime>"
+
 struct str emit_c(struct ast *ast);
+struct str emit_c_statement(struct ast *stmt);
+struct str emit_c_expression(struct ast *expr);
+/* what other translation units need to see of a top-level statement, empty when nothing */
+struct str emit_c_declaration(struct ast *stmt);
+/* the prototype of a function, internal ones are static */
+struct str emit_c_prototype(struct analyzable_function *fn, bool internal);
 
 #endif
@@ -0,0 +1,23 @@
+#ifndef __DEPS_H__
+#define __DEPS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <str.h>
+
+/* what a compilation wrote and read, written as a make rule like cc -MD does */
+struct deps {
+    struct str *targets;
+    size_t targets_count;
+    struct str *sources;
+    size_t sources_count;
+};
+
+void deps_add_target(struct deps *d, const char *path);
+/* a path already added is skipped */
+void deps_add_source(struct deps *d, const char *path);
+/* every source also gets an empty rule, so make goes on when one is deleted */
+bool deps_write(struct deps *d, const char *path);
+void deps_free(struct deps *d);
+
+#endif
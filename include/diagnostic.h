@@ -0,0 +1,30 @@
+#ifndef __DIAGNOSTIC_H__
+#define __DIAGNOSTIC_H__
+
+#include <stdio.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+#include <tanzanite.h>
+
+/* what a thread reports into while captured, instead of stderr */
+struct diagnostics {
+    struct tanzanite_diagnostic *items;
+    size_t count;
+    /* where fatal() returns to */
+    jmp_buf *unwind;
+};
+
+/* d is NULL to go back to printing, the capture only applies to the calling thread */
+void diagnostics_capture(struct diagnostics *d);
+void diagnostics_free(struct diagnostics *d);
+/* a captured diagnostic the way it is printed when nothing captures them */
+void diagnostic_print(FILE *f, const struct tanzanite_diagnostic *d);
+
+void report(enum tanzanite_severity severity, int line, int column, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/* reports an error and aborts, or unwinds to whoever captured the diagnostics */
+void fatal(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __DRIVER_H__
+#define __DRIVER_H__
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <str.h>
+
+/*
+ * Hands the generated C to the C compiler through a pipe instead of
+ * stdout. The compiler is $CC, or the one Tanzanite was configured with.
+ */
+struct driver {
+    /* the binary or object to write, NULL for a.out or a.o */
+    const char *output;
+    /* compile without linking */
+    bool object;
+    /* -O flag passed on, NULL for none */
+    const char *optimize;
+    /* when unset the C goes to stdout */
+    bool enabled;
+
+    pid_t pid;
+    FILE *in;
+    /* the compiler writes here, output only changes when its content does */
+    struct str tmp_path;
+};
+
+/* the file the C compiler builds */
+const char *driver_target(const struct driver *d);
+
+/* where the generated C goes, starts the C compiler and writes the prelude the first time */
+FILE *driver_out(struct driver *d);
+/* closes the pipe and waits for the C compiler, returns its exit status */
+int driver_finish(struct driver *d);
+/* stops the C compiler without letting it see the end of its input */
+void driver_cancel(struct driver *d);
+
+#endif
@@ -34,6 +34,7 @@ struct name {\
     struct name##_bucket *buckets;\
 };\
 void name##_free(struct name *hm);\
+void name##_clear(struct name *hm);\
 uint32_t name##_insert(struct name *hm, const char *key);\
 void name##_remove(struct name *hm, uint32_t it);\
 uint32_t name##_find(struct name *hm, const char *key);\
@@ -47,8 +48,14 @@ void name##_free(struct name *hm) {\
         free(hm->buckets);\
     memset(hm, 0, sizeof(*hm));\
 }\
+void name##_clear(struct name *hm) {\
+    for (uint32_t i = 0; i < hm->cap; i++)\
+        hm->buckets[i].state = HASH_EMPTY;\
+    hm->len = 0;\
+}\
 uint32_t name##_insert(struct name *hm, const char *key) {\
-    if (!name##_resize(hm))\
+    /* only grows, a cleared map keeps its room until something is removed */\
+    if ((hm->cap == 0 || hm->len * 4 > hm->cap * 3) && !name##_resize(hm))\
         return hm->cap;\
     uint32_t it = djb2(key, strlen(key)) % hm->cap;\
     while (hm->buckets[it].state == HASH_VALID && strcmp(key, hm->buckets[it].key))\
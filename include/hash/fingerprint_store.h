@@ -0,0 +1,10 @@
+#ifndef __HASH_FINGERPRINT_STORE_H__
+#define __HASH_FINGERPRINT_STORE_H__
+
+#include <hash.h>
+
+#include <analyzer/query.h>
+
+HASH_DECL(fingerprint_store, struct fingerprint);
+
+#endif
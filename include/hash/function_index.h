@@ -0,0 +1,9 @@
+#ifndef __HASH_FUNCTION_INDEX_H__
+#define __HASH_FUNCTION_INDEX_H__
+
+#include <stddef.h>
+#include <hash.h>
+
+HASH_DECL(function_index, size_t);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __HASH_PROFILE_STORE_H__
+#define __HASH_PROFILE_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <hash.h>
+
+/* the counters of one function, in the order codegen placed them */
+struct profile_counts {
+    uint64_t *counts;
+    size_t count;
+};
+
+HASH_DECL(profile_store, struct profile_counts);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef __HASH_QUERY_STORE_H__
+#define __HASH_QUERY_STORE_H__
+
+#include <hash.h>
+
+#include <analyzer/query.h>
+
+HASH_DECL(query_store, struct query_result);
+
+#endif
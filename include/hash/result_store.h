@@ -0,0 +1,10 @@
+#ifndef __HASH_RESULT_STORE_H__
+#define __HASH_RESULT_STORE_H__
+
+#include <hash.h>
+
+#include <server.h>
+
+HASH_DECL(result_store, struct server_result);
+
+#endif
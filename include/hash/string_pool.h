@@ -0,0 +1,8 @@
+#ifndef __HASH_STRING_POOL_H__
+#define __HASH_STRING_POOL_H__
+
+#include <hash.h>
+
+HASH_DECL(string_pool, uint32_t);
+
+#endif
@@ -9,6 +9,7 @@
 
 struct var_store_res {
     bool found;
+    uint32_t frame;
     struct analyzable_variable payload;
 };
 
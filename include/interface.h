@@ -0,0 +1,25 @@
+#ifndef __INTERFACE_H__
+#define __INTERFACE_H__
+
+#include <stdbool.h>
+#include <ast.h>
+
+#include <analyzer/context.h>
+
+/* directories searched for <module>.tzi, in the order they were added */
+void interface_add_path(const char *dir);
+/* forgets the directories and what was imported, for a process compiling one program after another */
+void interface_reset(void);
+
+/* the signatures of every function the program declares or defines, besides main */
+bool interface_write(struct analyzer_context *ctx, struct ast *program, const char *path);
+
+/* maps the interface of the imported module and adds its functions as declarations */
+struct ast interface_import(struct analyzer_context *ctx, struct ast *import);
+
+bool program_imports(struct ast *program);
+
+/* paths of the interfaces imported so far */
+const struct str *interface_imported(size_t *count);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef __JOBS_H__
+#define __JOBS_H__
+
+#include <stddef.h>
+
+/* what a job runs in its own process, the return value is its exit status */
+typedef int (*job_run)(size_t index, void *data);
+
+/*
+ * Runs run(i, data) for every i below count, each in a forked process.
+ * When make's jobserver is in MAKEFLAGS, every job past the first waits
+ * for a token from it, and jobs, when not 0, caps how many run at once.
+ * Without a jobserver, jobs run at once, 0 means 1. After a job fails no
+ * new ones start, the status of the first failure is returned.
+ */
+int jobs_run(size_t count, unsigned jobs, job_run run, void *data);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef __LAZY_H__
+#define __LAZY_H__
+
+#include <stdbool.h>
+
+/* when set, top-level function bodies are skimmed and only parsed once needed */
+extern bool lazy_bodies;
+
+#endif
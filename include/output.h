@@ -0,0 +1,17 @@
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <stdbool.h>
+#include <str.h>
+
+/*
+ * Files other tools build from are only replaced when their bytes change,
+ * so a rebuild that changes nothing leaves their mtime alone.
+ */
+
+/* renames tmp_path to path, or removes it when path already has the same content */
+bool output_commit(const char *tmp_path, const char *path);
+/* writes content to path through a temporary file, unless path already has it */
+bool output_write(const char *path, struct str content);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __PARSER_STATE_H__
+#define __PARSER_STATE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct ast;
+union YYSTYPE;
+struct YYLTYPE;
+
+/* how far into a top-level function signature the lazy token filter is */
+enum signature_state {
+    SIG_NONE,
+    SIG_NAME,
+    SIG_OPEN,
+    SIG_ARGS,
+    SIG_AFTER_ARGS,
+    SIG_TYPE,
+    SIG_BODY,
+};
+
+/* everything a single parse touches, so chunks of one input can be parsed at once */
+struct parser_state {
+    void *scanner;
+    struct ast *root;
+
+    /* byte offsets of the next unread input and of the last token */
+    uint64_t offset;
+    uint64_t token_offset;
+    int column;
+    /* where the last token starts, it ends at the current line and column */
+    int token_line;
+    int token_column;
+
+    enum signature_state signature;
+    int paren_depth;
+    int queued;
+    bool body_start;
+};
+
+/* provided by the lexer, bytes of NULL lexes stdin */
+void lex_begin(struct parser_state *ps, const char *bytes, uint64_t len, uint64_t offset, int line);
+void lex_end(struct parser_state *ps);
+int lex_token(union YYSTYPE *lval, void *scanner);
+int lex_line(struct parser_state *ps);
+const char *lex_text(struct parser_state *ps);
+
+int yylex(union YYSTYPE *lval, struct YYLTYPE *lloc, struct parser_state *ps);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <hash/profile_store.h>
+
+/* where an instrumented program writes its counters unless $TANZANITE_PROFILE says otherwise */
+#define PROFILE_DEFAULT_PATH "tanzanite.profile"
+#define PROFILE_HEADER "tanzanite-profile 1"
+
+/*
+ * What an instrumented program counted: a header line, then a line per
+ * function with its name, the number of counters and the counters, the
+ * first one being how often the function was called.
+ */
+struct profile {
+    struct profile_store functions;
+    /* calls of every function together */
+    uint64_t calls;
+};
+
+bool profile_read(struct profile *p, const char *path);
+/* NULL when the function never ran instrumented */
+const struct profile_counts *profile_find(struct profile *p, const char *name);
+void profile_free(struct profile *p);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef __QUERY_H__
+#define __QUERY_H__
+
+#include <stdio.h>
+#include <ast.h>
+
+#include <analyzer/context.h>
+
+/*
+ * Checks and emits the program like prepare() and emit_c(), but treats the
+ * checked body of every function as a query recorded under dir. A record
+ * holds the hash of the body's source and the fingerprints of the callee
+ * signatures and globals it was checked against; while all of them still
+ * match, the recorded C is reused and the body is neither parsed nor checked.
+ * Bodies have to be parsed lazily for this.
+ */
+void compile_incremental(struct analyzer_context *ctx, struct ast *program, const char *dir, const char *options, FILE *out);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __QUEUE_GLOBAL_READ_QUEUE_H__
+#define __QUEUE_GLOBAL_READ_QUEUE_H__
+
+#include <queue.h>
+
+QUEUE_DECL(global_read_queue, const char*);
+
+#endif
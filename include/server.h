@@ -0,0 +1,40 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <str.h>
+#include <tanzanite.h>
+
+/* a finished compile, kept by the server for requests with the same key */
+struct server_result {
+    int status;
+    struct str out;
+    struct str err;
+};
+
+/*
+ * What a worker runs for a request, with input in place of stdin. cacheable
+ * is set when the output only depends on the arguments and the input.
+ */
+typedef int (*server_compile)(int argc, char **argv, struct str *input, bool *cacheable);
+
+/* a request the server compiles in its own process, with input as the source */
+struct server_warm {
+    struct tanzanite_options options;
+    /* searched for imported interfaces, in order */
+    const char **import_paths;
+    size_t import_paths_count;
+    /* where the interface is written, NULL for none */
+    const char *interface;
+};
+
+/* fills warm from a request's arguments, false when they need a worker of their own */
+typedef bool (*server_options)(int argc, char **argv, struct server_warm *warm);
+
+/* serves compile requests on the Unix socket at path until killed */
+int server_run(const char *path, server_compile compile, server_options options);
+/* sends argv and stdin to the server at path and replays its answer */
+int server_forward(const char *path, int argc, char **argv);
+
+#endif
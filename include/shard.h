@@ -0,0 +1,16 @@
+#ifndef __SHARD_H__
+#define __SHARD_H__
+
+#include <stdbool.h>
+
+struct ast;
+
+/*
+ * Writes an analyzed program as count translation units, PREFIX-0.c up to
+ * PREFIX-<count - 1>.c, and PREFIX.h with the prototypes and globals they
+ * share. Functions keep their source order and are cut into ranges of about
+ * the same number of nodes, so editing one function moves few boundaries.
+ */
+bool emit_shards(struct ast *program, unsigned count, const char *prefix);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef __SOURCE_MAP_H__
+#define __SOURCE_MAP_H__
+
+#include <stdbool.h>
+#include <str.h>
+
+/*
+ * Follows the #line directives of generated C and writes to path, as JSON,
+ * which source line every line of the C after the first directive came from,
+ * blank lines left out:
+ *
+ *   {"version": 1, "file": "a.c", "sources": ["a.tz"], "mappings": [[5, 0, 2], ...]}
+ *
+ * A mapping is the line of the C, the index of the source and its line, both
+ * lines counted from 1. Directives naming something like "<runtime>" end the
+ * mapped lines until the next one. Unless keep is set the directives are
+ * taken out of code, and the lines are those of what is left. file is left
+ * out when generated is NULL.
+ */
+bool source_map_write(const char *path, struct str *code, bool keep, const char *generated);
+
+#endif
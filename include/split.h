@@ -0,0 +1,11 @@
+#ifndef __SPLIT_H__
+#define __SPLIT_H__
+
+#include <stdint.h>
+
+struct ast;
+
+/* parses the source as up to jobs chunks at once, cut before top-level definitions */
+struct ast *parse_split(const char *source, uint64_t size, unsigned jobs);
+
+#endif
@@ -28,8 +28,10 @@ void name##_free(struct name *stack) {\
     memset(stack, 0, sizeof(*stack));\
 }\
 uint32_t name##_push(struct name *stack) {\
-    if (stack->cap == stack->len)\
-        stack->data = realloc(stack->data, (stack->cap += STACK_MIN_CAP) * sizeof(type));\
+    if (stack->cap == stack->len) {\
+        stack->cap = stack->cap > 0 ? stack->cap * 2 : STACK_MIN_CAP;\
+        stack->data = realloc(stack->data, stack->cap * sizeof(type));\
+    }\
     uint32_t it = stack->len;\
     stack->len++;\
     return it;\
@@ -0,0 +1,16 @@
+#ifndef __STACK_AST_STACK_H__
+#define __STACK_AST_STACK_H__
+
+#include <stack.h>
+
+struct ast;
+
+/* one node of an iterative tree walk, state counts the children already visited */
+struct ast_frame {
+    struct ast *node;
+    uint32_t state;
+};
+
+STACK_DECL(ast_stack, struct ast_frame);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __STACK_BLOCK_STACK_H__
+#define __STACK_BLOCK_STACK_H__
+
+#include <stack.h>
+
+STACK_DECL(block_stack, uint8_t);
+
+#endif
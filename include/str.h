@@ -1,6 +1,7 @@
 #ifndef __STR_H__
 #define __STR_H__
 
+#include <stdio.h>
 #include <stdint.h>
 
 struct str {
@@ -10,5 +11,6 @@ struct str {
 
 struct str str_init(const char *string, uint64_t len);
 void str_free(struct str *str);
+struct str str_read(FILE *in);
 
 #endif
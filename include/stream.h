@@ -0,0 +1,16 @@
+#ifndef __STREAM_H__
+#define __STREAM_H__
+
+#include <stdio.h>
+#include <ast.h>
+
+#include <analyzer/context.h>
+
+/*
+ * Analyzes and emits the program one top-level statement at a time. Every
+ * function is checked once all signatures are known, written to out right
+ * away and its body freed, so only one function's output is held at once.
+ */
+void compile_stream(struct analyzer_context *ctx, struct ast *program, FILE *out);
+
+#endif
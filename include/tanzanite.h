@@ -0,0 +1,69 @@
+#ifndef __TANZANITE_H__
+#define __TANZANITE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Compiles Tanzanite source to C in process. A context keeps the analyzer
+ * state, the generated C and the diagnostics of its last compilation, and
+ * can be reused for any number of them, what a failed one left behind is
+ * freed with the next. A context must not be used from several threads at
+ * once, and neither can two different contexts compile at the same time:
+ * the parser's source, lazy_bodies, the codegen_* options and the node
+ * tracker are globals they share.
+ */
+struct tanzanite;
+
+enum tanzanite_severity {
+    TANZANITE_WARNING,
+    TANZANITE_ERROR,
+};
+
+struct tanzanite_diagnostic {
+    enum tanzanite_severity severity;
+    /* 0 when the problem isn't tied to a position */
+    int line;
+    int column;
+    char *message;
+};
+
+struct tanzanite_options {
+    /* only parse bodies of functions reachable from main */
+    bool lazy;
+    /* every function is an entry point, and main is optional */
+    bool module;
+    /* keep the bench blocks and add the harness that runs them */
+    bool bench;
+
+    /* the rest only changes the C, tanzanite_emit can apply other values */
+    /* count calls, branches and loop rounds */
+    bool instrument;
+    /* record when every call starts and ends */
+    bool trace;
+    /* the file #line directives name, none are emitted when NULL */
+    const char *source_name;
+};
+
+struct tanzanite *tanzanite_new(void);
+void tanzanite_free(struct tanzanite *tz);
+
+/* frees what the last compilation left in tz and keeps the room of its stores, compile does this first */
+void tanzanite_reset(struct tanzanite *tz);
+
+/* options can be NULL for the defaults, false when an error was reported */
+bool tanzanite_compile(struct tanzanite *tz, const struct tanzanite_options *options, const char *source, size_t size);
+
+/* emits the last successful compilation again, options can only differ in what changes the C */
+bool tanzanite_emit(struct tanzanite *tz, const struct tanzanite_options *options);
+
+/* the last successful compilation imported interfaces, its C depends on them as well */
+bool tanzanite_imports(struct tanzanite *tz);
+/* the signatures of what the last successful compilation exports, for modules importing it */
+bool tanzanite_write_interface(struct tanzanite *tz, const char *path);
+
+/* the C of the last successful compilation, owned by tz */
+const char *tanzanite_output(struct tanzanite *tz, size_t *size);
+size_t tanzanite_diagnostics(struct tanzanite *tz, const struct tanzanite_diagnostic **diagnostics);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/*
+ * C that --trace-functions adds to the program. When $TANZANITE_TRACE names
+ * a file, every traced call records when it starts and ends in a ring
+ * buffer of its thread, and the rings are written to the file as Chrome
+ * trace events when the program exits, or on the next call after SIGUSR1.
+ */
+
+/* what traced functions call, before them */
+extern const char trace_runtime[];
+/* writes the rings out, after tz_trace_names, which maps ids given to tz_trace_record to names */
+extern const char trace_writer[];
+
+#endif
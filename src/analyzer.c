@@ -1,12 +1,16 @@
 #include <ast.h>
 #include <analyzer/context.h>
 #include <analyzer.h>
+#include <interface.h>
+#include <call_graph.h>
+#include <diagnostic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <float.h>
 #include <hash/type_store.h>
+#include <stack/ast_stack.h>
 
 struct builtin_types {
     char *name;
@@ -45,15 +49,39 @@ static struct ast _prepare_vars(struct analyzer_context *ctx, struct ast *var, b
 static struct ast _prepare_fns(struct analyzer_context *ctx, struct ast *fun);
 static struct ast _prepare_conds(struct analyzer_context *ctx, struct ast *cond);
 static struct ast _prepare_loops(struct analyzer_context *ctx, struct ast *loop);
+static struct ast _prepare_bench(struct analyzer_context *ctx, struct ast *bench);
 static struct ast *_prepare_expr(struct analyzer_context *ctx, struct ast *expr);
+static void _prepare_operation_tree(struct analyzer_context *ctx, struct ast *root);
+static void _finish_operation(struct analyzer_context *ctx, struct ast *expr);
+static struct var_store_res _find_var(struct analyzer_context *ctx, const char *name);
 static struct analyzable_type _get_type(struct analyzer_context *ctx, struct ast *type);
 static struct analyzable_type _just_cast(struct analyzable_type current, struct analyzable_type target);
 static struct analyzable_type _attempt_cast(struct analyzable_type current, struct analyzable_type target);
 static bool _expect_type(struct analyzable_type current, const char *name);
 static void _assign_args_to_fn(struct analyzer_context *ctx, struct ast *fn, struct ast *first_arg);
 static void _assign_args_to_call(struct analyzer_context *ctx, struct analyzable_call *call, struct ast *first_arg);
+static unsigned _check_attributes(const char *name, unsigned attributes);
+static void _limit_effect(struct analyzer_context *ctx, enum fn_effect effect);
+static void _copy_analysis(struct analyzer_context *ctx, struct ast *program);
+static void _propagate_effects(struct ast *program);
+static void _mark_tail_calls(struct analyzable_function *fun);
 
 struct ast *prepare(struct analyzer_context *ctx, struct ast *to_process)
+{
+    prepare_globals(ctx, to_process);
+
+    const char *name = NULL;
+    while ((name = fn_call_queue_pop(&ctx->call_queue)) != NULL)
+        prepare_function(ctx, name);
+
+    _copy_analysis(ctx, to_process);
+    _propagate_effects(to_process);
+    var_store_pop_frame(&ctx->variables);
+
+    return to_process;
+}
+
+void prepare_globals(struct analyzer_context *ctx, struct ast *to_process)
 {
     const struct builtin_types *type_iter = types;
     while (type_iter->name != NULL) {
@@ -66,75 +94,230 @@ struct ast *prepare(struct analyzer_context *ctx, struct ast *to_process)
     }
 
     if (to_process->type != PROGRAM) {
-        fprintf(stderr, "expected PROGRAM, got %d!\n", to_process->type);
-        abort();
+        fatal("expected PROGRAM, got %d!", to_process->type);
     }
 
     var_store_push_frame(&ctx->variables);
 
-    struct ast *iter = to_process->u.program;
-    while (iter != NULL) {
+    /* bench blocks aren't part of the program unless it's built to run them */
+    struct ast **link = &to_process->u.program;
+    while (*link != NULL) {
+        struct ast *iter = *link;
+        if (iter->u.statement.current->type == BENCH && !ctx->bench) {
+            *link = iter->u.statement.next;
+            iter->u.statement.next = NULL;
+            free_node(iter);
+            continue;
+        }
+
         _prepare_global_statement(ctx, iter->u.statement.current);
-        iter = iter->u.statement.next;
+        link = &iter->u.statement.next;
     }
 
     uint32_t it = function_store_find(&ctx->functions, "main");
-    if (!hash_exists(&ctx->functions, it)) {
-        fprintf(stderr, "entrypoint is missing function main!\n");
-        abort();
+    if (hash_exists(&ctx->functions, it)) {
+        fn_call_queue_push(&ctx->call_queue, "main");
+    } else if (!ctx->module && ctx->benches == 0) {
+        fatal("entrypoint is missing function main!");
     }
-    struct analyzable_function *main_fn = &hash_value(&ctx->functions, it);
-    iter = main_fn->body;
+
+    if (!ctx->module && ctx->benches == 0)
+        return;
+
+    struct ast *iter = to_process->u.program;
+    while (iter != NULL) {
+        struct ast *stmt = iter->u.statement.current;
+        if (stmt->type == ANALYZE_FN && !stmt->u.a_fn.declaration && (ctx->module || stmt->u.a_fn.bench.str != NULL))
+            fn_call_queue_push(&ctx->call_queue, stmt->u.a_fn.name.str);
+        iter = iter->u.statement.next;
+    }
+}
+
+void prepare_function(struct analyzer_context *ctx, const char *name)
+{
+    uint32_t it = function_store_find(&ctx->functions, name);
+    struct analyzable_function *fun = &hash_value(&ctx->functions, it);
+
+    if (fun->checked)
+        return;
+
+    fun->checked = true;
+    if (fun->body == NULL)
+        return;
+    if (fun->body->type == LAZY_BODY)
+        parse_lazy_body(fun->body);
+
+    struct ast *iter = fun->body;
+    ctx->effect = FN_CONST;
     var_store_push_frame(&ctx->variables);
+    for (size_t i = 0; i < fun->args_count; i++) {
+        struct analyzable_fn_arg *arg = fun->args + i;
+        struct analyzable_variable *var = var_store_insert(&ctx->variables, arg->identifier.str);
+
+        var->type = arg->type;
+        var->identifier = arg->identifier;
+        var->is_declaration = true;
+
+        if (arg->default_value != NULL) {
+            var->is_declaration = false;
+            var->value = arg->default_value;
+        }
+    }
+
     while (iter != NULL) {
         _prepare_body_statements(ctx, iter->u.statement.current);
         iter = iter->u.statement.next;
     }
-    main_fn->checked = true;
-    var_store_pop_frame(&ctx->variables);
 
-    const char *name = NULL;
-    while ((name = fn_call_queue_pop(&ctx->call_queue)) != NULL) {
-        it = function_store_find(&ctx->functions, name);
-        struct analyzable_function *fun = &hash_value(&ctx->functions, it);
-        
-        if (fun->checked)
-            continue;
+    var_store_pop_frame(&ctx->variables);
+    _mark_tail_calls(fun);
+    fun->cost = count_nodes(fun->body);
+    fun->effect = ctx->effect;
+}
 
-        fun->checked = true;
-        if (fun->body == NULL)
+/* the statements hold copies of the signatures, codegen reads them from there */
+static void _copy_analysis(struct analyzer_context *ctx, struct ast *program)
+{
+    for (struct ast *iter = program->u.program; iter != NULL; iter = iter->u.statement.next) {
+        struct ast *stmt = iter->u.statement.current;
+        if (stmt->type != ANALYZE_FN || stmt->u.a_fn.declaration)
             continue;
 
-        iter = fun->body;
-        var_store_push_frame(&ctx->variables);
-        for (size_t i = 0; i < fun->args_count; i++) {
-            struct analyzable_fn_arg *arg = fun->args + i;
-            struct analyzable_variable *var = var_store_insert(&ctx->variables, arg->identifier.str);
+        uint32_t it = function_store_find(&ctx->functions, stmt->u.a_fn.name.str);
+        stmt->u.a_fn.cost = hash_value(&ctx->functions, it).cost;
+        stmt->u.a_fn.effect = hash_value(&ctx->functions, it).effect;
+    }
+}
 
-            var->type = arg->type;
-            var->identifier = arg->identifier;
-            var->is_declaration = true;
+/*
+ * A function promises no more than the functions it calls. Recursion, like a
+ * while loop, might never return, so functions that can call themselves again
+ * are impure, and lowering callers until nothing changes passes that on.
+ */
+static void _propagate_effects(struct ast *program)
+{
+    struct call_graph g;
+    call_graph_build(&g, program);
+    size_t *order = call_graph_order(&g);
+    bool *recursive = call_graph_recursive(&g);
+
+    for (size_t i = 0; i < g.count; i++) {
+        if (g.nodes[i].external_calls > 0 || recursive[i])
+            g.nodes[i].fn->u.a_fn.effect = FN_IMPURE;
+    }
 
-            if (arg->default_value != NULL) {
-                var->is_declaration = false;
-                var->value = arg->default_value;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < g.count; i++) {
+            struct call_graph_node *node = g.nodes + order[i];
+            for (size_t j = 0; j < node->callees_count; j++) {
+                enum fn_effect callee = g.nodes[node->callees[j]].fn->u.a_fn.effect;
+                if (callee < node->fn->u.a_fn.effect) {
+                    node->fn->u.a_fn.effect = callee;
+                    changed = true;
+                }
             }
         }
+    }
 
-        while (iter != NULL) {
-            _prepare_body_statements(ctx, iter->u.statement.current);
-            iter = iter->u.statement.next;
-        }
+    free(recursive);
+    free(order);
+    call_graph_free(&g);
+}
 
-        var_store_pop_frame(&ctx->variables);
+/* the statement a body ends with, NULL for an empty one */
+static struct ast *_last_statement(struct ast *body)
+{
+    if (body == NULL || body->type != STATEMENT)
+        return body;
+
+    while (body->u.statement.next != NULL)
+        body = body->u.statement.next;
+    return body->u.statement.current;
+}
+
+static void _mark_tail(struct analyzable_function *fun, struct ast *body)
+{
+    struct ast *last = _last_statement(body);
+    if (last == NULL)
+        return;
+
+    if (last->type == ANALYZE_FN_CALL && strcmp(last->u.a_fn_call.identifier.str, fun->name.str) == 0) {
+        last->u.a_fn_call.tail = true;
+    } else if (last->type == ANALYZE_IF) {
+        _mark_tail(fun, last->u.a_if.body);
+        for (size_t i = 0; i < last->u.a_if.elsifs_count; i++)
+            _mark_tail(fun, last->u.a_if.elsifs[i].body);
+        if (last->u.a_if.else_op != NULL && last->u.a_if.else_op->type == ELSE_COND)
+            _mark_tail(fun, last->u.a_if.else_op->u.else_statement);
     }
-    var_store_pop_frame(&ctx->variables);
+}
 
-    return to_process;
+static void _find_address(struct ast *node, void *data)
+{
+    if (node->type == UNARY && strcmp(node->u.unary.op, "&") == 0)
+        *(bool *)data = true;
+}
+
+/*
+ * A call to the function itself that nothing follows can reuse its frame.
+ * Not once an address is taken, a pointer to an argument or a local would
+ * see the next round's value instead of the caller's.
+ */
+static void _mark_tail_calls(struct analyzable_function *fun)
+{
+    bool address = false;
+    walk_nodes(fun->body, _find_address, &address);
+    if (fun->variadic || address)
+        return;
+
+    _mark_tail(fun, fun->body);
 }
 
+/*
+ * Signatures, and the bodies of functions, are only reachable through the
+ * function store. Bodies can be left alone, a check that failed halfway
+ * leaves one that is neither parsed nor analyzed.
+ */
+void clear_context(struct analyzer_context *ctx, bool bodies)
+{
+    for (uint32_t it = hash_begin(&ctx->functions); it < hash_end(&ctx->functions); it++) {
+        if (!hash_exists(&ctx->functions, it))
+            continue;
+
+        struct analyzable_function *fn = &hash_value(&ctx->functions, it);
+        for (size_t i = 0; i < fn->args_count; i++)
+            free_node(fn->args[i].default_value);
+        ast_free(fn->args);
+        if (bodies)
+            free_node(fn->body);
+    }
+
+    while (ctx->variables.len > 0)
+        var_store_pop_frame(&ctx->variables);
+    ctx->operations.len = 0;
+    function_store_clear(&ctx->functions);
+    type_store_clear(&ctx->types);
+    fn_call_queue_free(&ctx->call_queue);
+    global_read_queue_free(&ctx->global_reads);
+    ctx->record_globals = false;
+    ctx->benches = 0;
+}
+
+void free_context(struct analyzer_context *ctx)
+{
+    var_store_free(&ctx->variables);
+    function_store_free(&ctx->functions);
+    type_store_free(&ctx->types);
+    ast_stack_free(&ctx->operations);
+}
+
+/* the prepared statement takes the place of the parsed one, and where it was written */
 static void _prepare_body_statements(struct analyzer_context *ctx, struct ast *body)
 {
+    struct source_span span = body->span;
+
     switch (body->type) {
     case ASSIGNMENT:
     case VAR_DECL:
@@ -169,16 +352,21 @@ static void _prepare_body_statements(struct analyzer_context *ctx, struct ast *b
     case NEXT:
     case BREAK:
         break;
+    case BENCH:
+        fatal("bench %s can only be at the top level!", body->u.bench.name.str);
     case FN_DECL:
     case FN_DEF:
     default:
-        fprintf(stderr, "did not expect %d in function scope!\n", body->type);
-        abort();
+        fatal("did not expect %d in function scope!", body->type);
     }
+
+    body->span = span;
 }
 
 static void _prepare_global_statement(struct analyzer_context *ctx, struct ast *stmt)
 {
+    struct source_span span = stmt->span;
+
     switch (stmt->type) {
     case ASSIGNMENT:
     case VAR_DECL:
@@ -189,10 +377,17 @@ static void _prepare_global_statement(struct analyzer_context *ctx, struct ast *
     case FN_DEF:
         *stmt = _prepare_fns(ctx, stmt);
         break;
+    case IMPORT:
+        *stmt = interface_import(ctx, stmt);
+        break;
+    case BENCH:
+        *stmt = _prepare_bench(ctx, stmt);
+        break;
     default:
-        fprintf(stderr, "did not expect %d in global scope!\n", stmt->type);
-        abort();
+        fatal("did not expect %d in global scope!", stmt->type);
     }
+
+    stmt->span = span;
 }
 
 static void _prepare_body(struct analyzer_context *ctx, struct ast *body)
@@ -215,10 +410,9 @@ static struct ast _prepare_vars(struct analyzer_context *ctx, struct ast *var, b
         if (fn_arg)
             goto skip1;
 
-        struct var_store_res it = var_store_find(&ctx->variables, var->u.variable_declaration.identifier->u.identifier.str);
+        struct var_store_res it = _find_var(ctx, var->u.variable_declaration.identifier->u.identifier.str);
         if (it.found) {
-            fprintf(stderr, "variable %s already exists!\n", var->u.assignment.left->u.identifier.str);
-            abort();
+            fatal("variable %s already exists!", var->u.assignment.left->u.identifier.str);
         }
 skip1:
         variable.u.a_var.identifier = var->u.variable_declaration.identifier->u.identifier;
@@ -228,10 +422,9 @@ skip1:
         if (fn_arg)
             goto skip2;
 
-        struct var_store_res it = var_store_find(&ctx->variables, var->u.function_definition.ident->u.identifier.str);
+        struct var_store_res it = _find_var(ctx, var->u.function_definition.ident->u.identifier.str);
         if (it.found) {
-            fprintf(stderr, "variable %s already exists!\n", var->u.assignment.left->u.identifier.str);
-            abort();
+            fatal("variable %s already exists!", var->u.assignment.left->u.identifier.str);
         }
 skip2:
         variable.u.a_var.identifier = var->u.variable_definition.identifier->u.identifier;
@@ -248,15 +441,16 @@ skip2:
         variable.u.a_var.is_declaration = false;
     } else if (var->type == ASSIGNMENT) {
         if (var->u.assignment.left->type != IDENTIFIER) {
-            fprintf(stderr, "expected IDENT on left side of assignment!\n");
-            abort();
+            fatal("expected IDENT on left side of assignment!");
         }
 
         if (fn_arg)
             goto skip3;
 
-        struct var_store_res it = var_store_find(&ctx->variables, var->u.assignment.left->u.identifier.str);
+        struct var_store_res it = _find_var(ctx, var->u.assignment.left->u.identifier.str);
         if (it.found) {
+            if (it.frame == stack_bottom(&ctx->variables))
+                _limit_effect(ctx, FN_IMPURE);
             var->u.assignment.right = _prepare_expr(ctx, var->u.assignment.right);
             return *var;
         }
@@ -289,8 +483,7 @@ static struct ast _prepare_fns(struct analyzer_context *ctx, struct ast *fun)
         uint32_t it = function_store_find(&ctx->functions, fun->u.function_declaration.ident->u.identifier.str);
         if (hash_exists(&ctx->functions, it)) {
             struct analyzable_function f = hash_value(&ctx->functions, it);
-            fprintf(stderr, "function %s has already been %s!\n", f.name.str, f.declaration ? "declared" : "defined");
-            abort();
+            fatal("function %s has already been %s!", f.name.str, f.declaration ? "declared" : "defined");
         }
 
         fn.u.a_fn.return_type = _get_type(ctx, fun->u.function_declaration.return_type);
@@ -302,6 +495,8 @@ static struct ast _prepare_fns(struct analyzer_context *ctx, struct ast *fun)
         fn.u.a_fn.immutable = fun->u.function_declaration.immutable;
         fn.u.a_fn.declaration = true;
         fn.u.a_fn.checked = false;
+        fn.u.a_fn.attributes = _check_attributes(fn.u.a_fn.name.str, fun->u.function_declaration.attributes);
+        fn.u.a_fn.exported = fn.u.a_fn.attributes & FN_EXPORT;
 
         it = function_store_insert(&ctx->functions, fn.u.a_fn.name.str);
         hash_value(&ctx->functions, it) = fn.u.a_fn;
@@ -310,8 +505,7 @@ static struct ast _prepare_fns(struct analyzer_context *ctx, struct ast *fun)
         if (hash_exists(&ctx->functions, it)) {
             struct analyzable_function f = hash_value(&ctx->functions, it);
             if (f.declaration == false) {
-                fprintf(stderr, "function %s has already been %s!\n", f.name.str, f.declaration ? "declared" : "defined");
-                abort();
+                fatal("function %s has already been %s!", f.name.str, f.declaration ? "declared" : "defined");
             }
         }
 
@@ -324,30 +518,27 @@ static struct ast _prepare_fns(struct analyzer_context *ctx, struct ast *fun)
         fn.u.a_fn.immutable = fun->u.function_definition.immutable;
         fn.u.a_fn.declaration = false;
         fn.u.a_fn.checked = false;
+        fn.u.a_fn.attributes = fun->u.function_definition.attributes;
 
         if (hash_exists(&ctx->functions, it)) {
             struct analyzable_function f = hash_value(&ctx->functions, it);
             if (strcmp(f.return_type.identifier.str, fn.u.a_fn.return_type.identifier.str) != 0) {
-                fprintf(stderr, "return type missmatch! expected %s got %s!\n", f.return_type.identifier.str,
+                fatal("return type missmatch! expected %s got %s!", f.return_type.identifier.str,
                     fn.u.a_fn.return_type.identifier.str);
-                abort();
             }
 
             if (f.immutable != fn.u.a_fn.immutable) {
-                fprintf(stderr, "function type missmatch! expected %s got %s!\n", f.immutable ? "C" : "Tanzanite",
+                fatal("function type missmatch! expected %s got %s!", f.immutable ? "C" : "Tanzanite",
                     fn.u.a_fn.immutable ? "C" : "Tanzanite");
-                abort();
             }
 
             if (f.variadic != fn.u.a_fn.variadic) {
-                fprintf(stderr, "function variadic missmatch! expected %s got %s!\n", f.variadic ? "yes" : "no",
+                fatal("function variadic missmatch! expected %s got %s!", f.variadic ? "yes" : "no",
                     fn.u.a_fn.variadic ? "yes" : "no");
-                abort();
             }
 
             if (f.args_count != fn.u.a_fn.args_count) {
-                fprintf(stderr, "argument count missmatch! expected %ld got %ld!\n", f.args_count, fn.u.a_fn.args_count);
-                abort();
+                fatal("argument count missmatch! expected %ld got %ld!", f.args_count, fn.u.a_fn.args_count);
             }
 
             for (size_t i = 0; i < f.args_count; i++) {
@@ -355,28 +546,29 @@ static struct ast _prepare_fns(struct analyzer_context *ctx, struct ast *fun)
                 struct analyzable_fn_arg *def = fn.u.a_fn.args + i;
 
                 if (strcmp(decl->identifier.str, def->identifier.str) != 0) {
-                    fprintf(stderr, "%ld. arg name missmatch! expected %s got %s!\n", i + 1, decl->identifier.str,
+                    fatal("%ld. arg name missmatch! expected %s got %s!", i + 1, decl->identifier.str,
                         def->identifier.str);
-                    abort();
                 }
 
                 if (strcmp(decl->type.identifier.str, def->type.identifier.str) != 0) {
-                    fprintf(stderr, "%ld. arg type missmatch! expected %s got %s!\n", i + 1, decl->type.identifier.str,
+                    fatal("%ld. arg type missmatch! expected %s got %s!", i + 1, decl->type.identifier.str,
                         def->type.identifier.str);
-                    abort();
                 }
 
                 if (decl->type.pointer_depth != def->type.pointer_depth) {
-                    fprintf(stderr, "%ld. arg pointer depth missmath! expected %ld got %ld!\n", i + 1,
+                    fatal("%ld. arg pointer depth missmath! expected %ld got %ld!", i + 1,
                         decl->type.pointer_depth, def->type.pointer_depth);
-                    abort();
                 }
             }
 
-            free(fn.u.a_fn.args);
+            ast_free(fn.u.a_fn.args);
             fn.u.a_fn.args = f.args;
+            fn.u.a_fn.attributes |= f.attributes;
         }
 
+        fn.u.a_fn.attributes = _check_attributes(fn.u.a_fn.name.str, fn.u.a_fn.attributes);
+        fn.u.a_fn.exported = (fn.u.a_fn.attributes & FN_EXPORT) || strcmp(fn.u.a_fn.name.str, "main") == 0;
+
         if (!hash_exists(&ctx->functions, it))
             it = function_store_insert(&ctx->functions, fn.u.a_fn.name.str);
 
@@ -386,6 +578,38 @@ static struct ast _prepare_fns(struct analyzer_context *ctx, struct ast *fun)
     return fn;
 }
 
+/* a bench block is a void function without arguments, the harness calls it as often as it needs */
+static struct ast _prepare_bench(struct analyzer_context *ctx, struct ast *bench)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "tz_bench_%zu", ctx->benches++);
+    struct ast *type = type_node(pointer_node(NULL, identifier_node(ast_str("void", 4))));
+    struct ast *def = fn_def_node(type, identifier_node(ast_str(name, strlen(name))), NULL, bench->u.bench.body, false);
+
+    struct ast fn = _prepare_fns(ctx, def);
+    fn.u.a_fn.bench = bench->u.bench.name;
+    /* inlined into the harness loop, work that doesn't change between runs could be done once */
+    fn.u.a_fn.attributes |= FN_NOINLINE;
+    uint32_t it = function_store_find(&ctx->functions, fn.u.a_fn.name.str);
+    hash_value(&ctx->functions, it).bench = fn.u.a_fn.bench;
+    hash_value(&ctx->functions, it).attributes = fn.u.a_fn.attributes;
+
+    free_node_shell(def);
+    return fn;
+}
+
+static unsigned _check_attributes(const char *name, unsigned attributes)
+{
+    if ((attributes & FN_INLINE) && (attributes & FN_NOINLINE)) {
+        fatal("function %s can't be both inline and noinline!", name);
+    }
+    if ((attributes & FN_HOT) && (attributes & FN_COLD)) {
+        fatal("function %s can't be both hot and cold!", name);
+    }
+
+    return attributes;
+}
+
 static struct ast _prepare_conds(struct analyzer_context *ctx, struct ast *cond)
 {
     struct ast c = {0};
@@ -394,16 +618,14 @@ static struct ast _prepare_conds(struct analyzer_context *ctx, struct ast *cond)
     if (cond->type == EXPR_IF) {
         c.u.a_if.expression = _prepare_expr(ctx, cond->u.expression_if.condition);
         if (!_expect_type(_get_type(ctx, c.u.a_if.expression), "bool")) {
-            fprintf(stderr, "if/unless expects a bool operation!\n");
-            abort();
+            fatal("if/unless expects a bool operation!");
         }
         c.u.a_if.body = _prepare_expr(ctx, cond->u.expression_if.expr);
         c.u.a_if.unless = cond->u.expression_if.unless;
     } else if (cond->type == IF_COND) {
         c.u.a_if.expression = _prepare_expr(ctx, cond->u.if_statement.expr);
         if (!_expect_type(_get_type(ctx, c.u.a_if.expression), "bool")) {
-            fprintf(stderr, "if/unless expects a bool operation!\n");
-            abort();
+            fatal("if/unless expects a bool operation!");
         }
         c.u.a_if.body = cond->u.if_statement.body;
 
@@ -425,14 +647,13 @@ static struct ast _prepare_conds(struct analyzer_context *ctx, struct ast *cond)
         }
 
         if (count > 0) {
-            struct analyzable_elsif *elsifs = calloc(count, sizeof(*elsifs));
+            struct analyzable_elsif *elsifs = ast_alloc(count, sizeof(*elsifs));
             iter = cond->u.if_statement.next;
             for (size_t i = 0; i < count; i++) {
                 struct analyzable_elsif *ptr = elsifs + i;
                 ptr->expression = _prepare_expr(ctx, iter->u.elsif_statement.expr);
                 if (!_expect_type(_get_type(ctx, ptr->expression), "bool")) {
-                    fprintf(stderr, "elsif expects a bool operation!\n");
-                    abort();
+                    fatal("elsif expects a bool operation!");
                 }
                 ptr->body = iter->u.elsif_statement.body;
                 if (ptr->body != NULL)
@@ -459,11 +680,12 @@ static struct ast _prepare_loops(struct analyzer_context *ctx, struct ast *loop)
         if (!l.u.a_while.infinite) {
             l.u.a_while.expr = _prepare_expr(ctx, loop->u.while_statement.expr);
             if (!_expect_type(_get_type(ctx, l.u.a_while.expr), "bool")) {
-                fprintf(stderr, "if/unless expects a bool operation!\n");
-                abort();
+                fatal("if/unless expects a bool operation!");
             }
         }
 
+        /* nothing says it ends, and calls to pure functions can be dropped */
+        _limit_effect(ctx, FN_IMPURE);
         l.u.a_while.body = loop->u.a_while.body;
 
         if (l.u.a_while.body != NULL)
@@ -473,8 +695,12 @@ static struct ast _prepare_loops(struct analyzer_context *ctx, struct ast *loop)
         l.u.a_for.expr = loop->u.for_statement.expr;
 
         if (l.u.a_for.expr->type != RANGE) {
-            fprintf(stderr, "for loop can (rn) take only range!\n");
-            abort();
+            fatal("for loop can (rn) take only range!");
+        }
+
+        /* XXX: codegen can't loop without one either, it fails here rather than halfway through the C */
+        if (loop->u.for_statement.capture == NULL) {
+            fatal("range has only 1 payload, got 0!");
         }
 
         if (loop->u.for_statement.capture != NULL) {
@@ -488,12 +714,11 @@ static struct ast _prepare_loops(struct analyzer_context *ctx, struct ast *loop)
 
             /* XXX: bad, very bad, but for now it supports only ranges */
             if (count != 1) {
-                fprintf(stderr, "range has only 1 payload, got %ld!\n", count);
-                abort();
+                fatal("range has only 1 payload, got %ld!", count);
             }
 
             struct analyzable_type type = _get_type(ctx, l.u.a_for.expr);
-            struct analyzable_payload *payloads = calloc(count, sizeof(*payloads));
+            struct analyzable_payload *payloads = ast_alloc(count, sizeof(*payloads));
 
             iter = loop->u.for_statement.capture;
             for (size_t i = 0; i < count; i++) {
@@ -513,10 +738,9 @@ static struct ast _prepare_loops(struct analyzer_context *ctx, struct ast *loop)
 
             for (size_t i = 0; i < l.u.a_for.payload_count; i++) {
                 struct analyzable_payload *ptr = l.u.a_for.payloads + i;
-                struct var_store_res tmp_it = var_store_find(&ctx->variables, ptr->identifier.str);
+                struct var_store_res tmp_it = _find_var(ctx, ptr->identifier.str);
                 if (tmp_it.found) {
-                    fprintf(stderr, "variable %s already exists!\n", ptr->identifier.str);
-                    abort();
+                    fatal("variable %s already exists!", ptr->identifier.str);
                 }
                 struct analyzable_variable *it = var_store_insert(&ctx->variables, ptr->identifier.str);
                 it->type = ptr->type;
@@ -536,6 +760,23 @@ static struct ast _prepare_loops(struct analyzer_context *ctx, struct ast *loop)
     return l;
 }
 
+/* a lookup that ends in the global frame, or finds nothing, depends on the globals */
+static struct var_store_res _find_var(struct analyzer_context *ctx, const char *name)
+{
+    struct var_store_res res = var_store_find(&ctx->variables, name);
+    if (ctx->record_globals && (!res.found || res.frame == stack_bottom(&ctx->variables)))
+        global_read_queue_push(&ctx->global_reads, name);
+    if (res.found && res.frame == stack_bottom(&ctx->variables))
+        _limit_effect(ctx, FN_PURE);
+    return res;
+}
+
+static void _limit_effect(struct analyzer_context *ctx, enum fn_effect effect)
+{
+    if (effect < ctx->effect)
+        ctx->effect = effect;
+}
+
 static struct analyzable_type _get_type(struct analyzer_context *ctx, struct ast *type)
 {
     struct analyzable_type t = {0};
@@ -559,8 +800,7 @@ start:
         type = ptr_iter->u.pointer.current;
         uint32_t it = type_store_find(&ctx->types, type->u.identifier.str);
         if (!hash_exists(&ctx->types, it)) {
-            fprintf(stderr, "unable to resolve type: %s!\n", type->u.identifier.str);
-            abort();
+            fatal("unable to resolve type: %s!", type->u.identifier.str);
         }
 
         t = hash_value(&ctx->types, it);
@@ -569,8 +809,7 @@ start:
         break;
     case RANGE: {
         if (type->u.range.start >= type->u.range.end) {
-            fprintf(stderr, "start must be less than end in range!\n");
-            abort();
+            fatal("start must be less than end in range!");
         }
         int64_t val = type->u.range.end;
         const char *type = NULL;
@@ -605,17 +844,20 @@ start:
         return type->u.a_operation.result_type;
     case ANALYZE_TYPE_CAST:
         return type->u.a_cast.target;
+    case ANALYZE_EMITTED:
+        return type->u.a_emitted.result;
     case ANALYZE_IF:
         return type->u.a_if.result_type;
     case ANALYZE_FN_CALL:
         return type->u.a_fn_call.result_type;
     case BRACKETS:
-        return _get_type(ctx, type->u.bracket);
+        type = type->u.bracket;
+        goto start;
     case ASSIGNMENT:
-        return _get_type(ctx, type->u.assignment.right);
+        type = type->u.assignment.right;
+        goto start;
     default:
-        fprintf(stderr, "expected type nodes, got %d!\n", type->type);
-        abort();
+        fatal("expected type nodes, got %d!", type->type);
     }
 
     return t;
@@ -623,6 +865,11 @@ start:
 
 static struct analyzable_type _just_cast(struct analyzable_type current, struct analyzable_type target)
 {
+    /* pointer arithmetic keeps the pointer type */
+    if (current.pointer_depth > 0 && target.pointer_depth == 0)
+        return current;
+    if (target.pointer_depth > 0 && current.pointer_depth == 0)
+        return target;
     if (current.size > target.size)
         return current;
     return target;
@@ -643,7 +890,8 @@ static struct ast *_prepare_expr(struct analyzer_context *ctx, struct ast *expr)
 
     switch (expr->type) {
     case BRACKETS:
-        expr->u.bracket = _prepare_expr(ctx, expr->u.bracket);
+    case OPERATION:
+        _prepare_operation_tree(ctx, expr);
         break;
     case RANGE:
         break;
@@ -707,10 +955,9 @@ static struct ast *_prepare_expr(struct analyzer_context *ctx, struct ast *expr)
         struct analyzable_value v = {0};
 
         v.value = dup_node(expr);
-        struct var_store_res it = var_store_find(&ctx->variables, expr->u.identifier.str);
+        struct var_store_res it = _find_var(ctx, expr->u.identifier.str);
         if (!it.found) {
-            fprintf(stderr, "variable %s could not be found!\n", expr->u.identifier.str);
-            abort();
+            fatal("variable %s could not be found!", expr->u.identifier.str);
         }
 
         v.result = it.payload.type;
@@ -755,6 +1002,13 @@ static struct ast *_prepare_expr(struct analyzer_context *ctx, struct ast *expr)
     case UNARY: {
         struct analyzable_value v = {0};
 
+        /* ++ and -- write, anything but a local can outlive the call */
+        if (strcmp(expr->u.unary.op, "++") == 0 || strcmp(expr->u.unary.op, "--") == 0) {
+            struct ast *target = expr->u.unary.value;
+            if (target->type != IDENTIFIER || _find_var(ctx, target->u.identifier.str).frame == stack_bottom(&ctx->variables))
+                _limit_effect(ctx, FN_IMPURE);
+        }
+
         expr->u.unary.value = _prepare_expr(ctx, expr->u.unary.value);
         struct analyzable_type t = _get_type(ctx, expr->u.unary.value);
         if (strcmp(expr->u.unary.op, "&") == 0)
@@ -776,9 +1030,9 @@ static struct ast *_prepare_expr(struct analyzer_context *ctx, struct ast *expr)
         struct analyzable_type t = _get_type(ctx, expr->u.to_deref);
 
         if (t.pointer_depth < 1) {
-            fprintf(stderr, "expected pointer type, got %s!\n", t.identifier.str);
-            abort();
+            fatal("expected pointer type, got %s!", t.identifier.str);
         }
+        _limit_effect(ctx, FN_PURE);
 
         t.pointer_depth--;
         v.value = dup_node(expr);
@@ -788,39 +1042,6 @@ static struct ast *_prepare_expr(struct analyzer_context *ctx, struct ast *expr)
         expr->u.a_value = v;
         }
         break;
-    case OPERATION: {
-        struct analyzable_operation o = {0};
-        expr->u.operation.left = _prepare_expr(ctx, expr->u.operation.left);
-        expr->u.operation.right = _prepare_expr(ctx, expr->u.operation.right);
-
-        o.result_type = _just_cast(_get_type(ctx, expr->u.operation.left),
-                                      _get_type(ctx, expr->u.operation.right));
-        /* TODO: THIS */
-        if (strcmp(expr->u.operation.op, "//") == 0) {
-            fprintf(stderr, "// is not supported yet!\n");
-            abort();
-        } else if (strcmp(expr->u.operation.op, "|>") == 0) {
-            fprintf(stderr, "|> is not supported yet!\n");
-            abort();
-        } else if (strcmp(expr->u.operation.op, "==") == 0)
-            goto assign_bool;
-        else if (strcmp(expr->u.operation.op, "!=") == 0)
-            goto assign_bool;
-        else if (strcmp(expr->u.operation.op, "&&") == 0)
-            goto assign_bool;
-        else if (strcmp(expr->u.operation.op, "||") == 0) {
-assign_bool:
-            uint32_t it = type_store_find(&ctx->types, "bool");
-            o.result_type = hash_value(&ctx->types, it);
-        }
-        o.left = expr->u.operation.left;
-        o.right = expr->u.operation.right;
-        o.operation = expr->u.operation.op;
-
-        expr->type = ANALYZE_OPERATION;
-        expr->u.a_operation = o;
-        }
-        break;
     case TYPE_CAST: {
         struct analyzable_cast c = {0};
         expr->u.type_cast.expr = _prepare_expr(ctx, expr->u.type_cast.expr);
@@ -836,8 +1057,7 @@ assign_bool:
         struct analyzable_if cond = {0};
         cond.expression = _prepare_expr(ctx, expr->u.if_expression.expr);
         if (!_expect_type(_get_type(ctx, cond.expression), "bool")) {
-            fprintf(stderr, "if/unless expects a bool operation!\n");
-            abort();
+            fatal("if/unless expects a bool operation!");
         }
         cond.body = _prepare_expr(ctx, expr->u.if_expression.val);
         cond.unless = expr->u.if_expression.unless;
@@ -866,13 +1086,94 @@ assign_bool:
         break;
     case FIELD_ACCESS:
     default:
-        fprintf(stderr, "did not expect %d in expression!\n", expr->type);
-        abort();
+        fatal("did not expect %d in expression!", expr->type);
     }
 
     return expr;
 }
 
+/*
+ * Operations and brackets nest as deep as the input does (a generated sum of
+ * 100k terms is 100k levels), so they are walked with a heap stack instead of
+ * recursion. Children are still prepared left to right.
+ */
+static void _prepare_operation_tree(struct analyzer_context *ctx, struct ast *root)
+{
+    /* leaves can hold operations of their own, those walk above base */
+    struct ast_stack *stack = &ctx->operations;
+    uint32_t base = stack->len;
+    uint32_t it = ast_stack_push(stack);
+    stack_value(stack, it) = (struct ast_frame){ root, 0 };
+
+    while (stack->len > base) {
+        struct ast_frame *frame = &stack_value(stack, stack_top(stack));
+        struct ast *node = frame->node;
+        struct ast *child = NULL;
+
+        switch (frame->state++) {
+        case 0:
+            child = node->type == BRACKETS ? node->u.bracket : node->u.operation.left;
+            break;
+        case 1:
+            if (node->type == OPERATION) {
+                child = node->u.operation.right;
+                break;
+            }
+            /* fallthrough */
+        default:
+            if (node->type == OPERATION)
+                _finish_operation(ctx, node);
+            ast_stack_pop(stack);
+            continue;
+        }
+
+        if (child != NULL && (child->type == OPERATION || child->type == BRACKETS)) {
+            it = ast_stack_push(stack);
+            stack_value(stack, it) = (struct ast_frame){ child, 0 };
+        } else {
+            _prepare_expr(ctx, child);
+        }
+    }
+}
+
+static void _finish_operation(struct analyzer_context *ctx, struct ast *expr)
+{
+    struct analyzable_operation o = {0};
+
+    o.result_type = _just_cast(_get_type(ctx, expr->u.operation.left),
+                                  _get_type(ctx, expr->u.operation.right));
+    /* TODO: THIS */
+    if (strcmp(expr->u.operation.op, "//") == 0) {
+        fatal("// is not supported yet!");
+    } else if (strcmp(expr->u.operation.op, "|>") == 0) {
+        fatal("|> is not supported yet!");
+    } else if (strcmp(expr->u.operation.op, "==") == 0)
+        goto assign_bool;
+    else if (strcmp(expr->u.operation.op, "!=") == 0)
+        goto assign_bool;
+    else if (strcmp(expr->u.operation.op, "<") == 0)
+        goto assign_bool;
+    else if (strcmp(expr->u.operation.op, "<=") == 0)
+        goto assign_bool;
+    else if (strcmp(expr->u.operation.op, ">") == 0)
+        goto assign_bool;
+    else if (strcmp(expr->u.operation.op, ">=") == 0)
+        goto assign_bool;
+    else if (strcmp(expr->u.operation.op, "&&") == 0)
+        goto assign_bool;
+    else if (strcmp(expr->u.operation.op, "||") == 0) {
+assign_bool:
+        uint32_t it = type_store_find(&ctx->types, "bool");
+        o.result_type = hash_value(&ctx->types, it);
+    }
+    o.left = expr->u.operation.left;
+    o.right = expr->u.operation.right;
+    o.operation = expr->u.operation.op;
+
+    expr->type = ANALYZE_OPERATION;
+    expr->u.a_operation = o;
+}
+
 static bool _expect_type(struct analyzable_type current, const char *name)
 {
     if (strcmp(current.identifier.str, name) == 0)
@@ -897,7 +1198,7 @@ static void _assign_args_to_fn(struct analyzer_context *ctx, struct ast *fn, str
     }
 
     fn->u.a_fn.args_count = arg_count;
-    fn->u.a_fn.args = calloc(arg_count, sizeof(struct analyzable_fn_arg));
+    fn->u.a_fn.args = ast_alloc(arg_count, sizeof(struct analyzable_fn_arg));
 
     iter = first_arg;
     for (size_t i = 0; i < arg_count; i++) {
@@ -912,15 +1213,14 @@ static void _assign_args_to_fn(struct analyzer_context *ctx, struct ast *fn, str
             cast.value = ptr->default_value;
             cast.target = _attempt_cast(_get_type(ctx, cast.value), ptr->type);
 
-            struct ast *c = calloc(1, sizeof(*c));
+            struct ast *c = ast_alloc(1, sizeof(*c));
             c->type = ANALYZE_TYPE_CAST;
             c->u.a_cast = cast;
             ptr->default_value = c;
         }
 
         if (needs_def_val && ptr->default_value == NULL) {
-            fprintf(stderr, "%ld. arg %s is expected to have default value!\n", i + 1, ptr->identifier.str);
-            abort();
+            fatal("%ld. arg %s is expected to have default value!", i + 1, ptr->identifier.str);
         }
 
         if (ptr->default_value != NULL)
@@ -942,8 +1242,7 @@ static void _assign_args_to_call(struct analyzer_context *ctx, struct analyzable
 
     uint32_t it = function_store_find(&ctx->functions, call->identifier.str);
     if (!hash_exists(&ctx->functions, it)) {
-        fprintf(stderr, "funciton call to unknown function %s!\n", call->identifier.str);
-        abort();
+        fatal("funciton call to unknown function %s!", call->identifier.str);
     }
 
     struct analyzable_function *fn_signature = &hash_value(&ctx->functions, it);
@@ -961,19 +1260,17 @@ static void _assign_args_to_call(struct analyzer_context *ctx, struct analyzable
         for (size_t i = arg_count; i < limit; i++) {
             struct analyzable_fn_arg *ptr = fn_signature->args + i;
             if (ptr->default_value == NULL) {
-                fprintf(stderr, "function %s requires %ld arguments, got %ld!\n",
+                fatal("function %s requires %ld arguments, got %ld!",
                     call->identifier.str, limit, i);
-                abort();
             }
         }
     }
 
     if (!fn_signature->variadic && arg_count > limit) {
-        fprintf(stderr, "function %s has too many arguments and is not variadic!\n", call->identifier.str);
-        abort();
+        fatal("function %s has too many arguments and is not variadic!", call->identifier.str);
     }
 
-    struct analyzable_call_arg *args = calloc(limit, sizeof(*args));
+    struct analyzable_call_arg *args = ast_alloc(limit, sizeof(*args));
 
     iter = first_arg;
     for (size_t i = 0; i < arg_count; i++) {
@@ -1002,6 +1299,7 @@ static void _assign_args_to_call(struct analyzer_context *ctx, struct analyzable
         struct analyzable_call_arg *arg = args + i;
 
         arg->value = ptr->default_value;
+        arg->default_value = true;
     }
 
     call->args = args;
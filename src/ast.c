@@ -3,10 +3,122 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stack/ast_stack.h>
+
+/* NULL unless what trees own is being tracked */
+static struct ast_tracker *tracker = NULL;
+
+/* open addressing on the block's address, the capacity is a power of two */
+static size_t _tracked_slot(struct ast_tracker *t, void *block)
+{
+    size_t i = (((uintptr_t)block >> 4) * 11400714819323198485ull) & (t->cap - 1);
+    while (t->slots[i] != NULL && t->slots[i] != block)
+        i = (i + 1) & (t->cap - 1);
+    return i;
+}
+
+static void _track(void *block)
+{
+    if (tracker == NULL || block == NULL)
+        return;
+
+    if ((tracker->len + 1) * 4 > tracker->cap * 3) {
+        struct ast_tracker grown = { calloc(tracker->cap > 0 ? tracker->cap * 2 : 256, sizeof(*grown.slots)),
+            tracker->cap > 0 ? tracker->cap * 2 : 256, tracker->len };
+        for (size_t i = 0; i < tracker->cap; i++) {
+            if (tracker->slots[i] != NULL)
+                grown.slots[_tracked_slot(&grown, tracker->slots[i])] = tracker->slots[i];
+        }
+        free(tracker->slots);
+        *tracker = grown;
+    }
+
+    size_t i = _tracked_slot(tracker, block);
+    if (tracker->slots[i] == NULL)
+        tracker->len++;
+    tracker->slots[i] = block;
+}
+
+static void _untrack(void *block)
+{
+    if (tracker == NULL || tracker->len == 0 || block == NULL)
+        return;
+
+    size_t i = _tracked_slot(tracker, block);
+    if (tracker->slots[i] == NULL)
+        return;
+
+    tracker->slots[i] = NULL;
+    tracker->len--;
+    /* the rest of the run goes back in, or a probe would stop at the hole */
+    for (size_t j = (i + 1) & (tracker->cap - 1); tracker->slots[j] != NULL; j = (j + 1) & (tracker->cap - 1)) {
+        void *moved = tracker->slots[j];
+        tracker->slots[j] = NULL;
+        tracker->slots[_tracked_slot(tracker, moved)] = moved;
+    }
+}
+
+static struct ast *_new_node(void)
+{
+    return ast_alloc(1, sizeof(struct ast));
+}
+
+void ast_track(struct ast_tracker *t)
+{
+    tracker = t;
+}
+
+void ast_tracker_clear(struct ast_tracker *t)
+{
+    for (size_t i = 0; i < t->cap; i++) {
+        free(t->slots[i]);
+        t->slots[i] = NULL;
+    }
+    t->len = 0;
+}
+
+void ast_tracker_free(struct ast_tracker *t)
+{
+    ast_tracker_clear(t);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+void *ast_alloc(size_t count, size_t size)
+{
+    void *block = calloc(count, size);
+    _track(block);
+    return block;
+}
+
+void ast_free(void *block)
+{
+    _untrack(block);
+    free(block);
+}
+
+struct str ast_str(const char *s, uint64_t len)
+{
+    struct str copy = str_init(s, len);
+    _track(copy.str);
+    return copy;
+}
+
+void ast_str_free(struct str *s)
+{
+    _untrack(s->str);
+    str_free(s);
+}
+
+void free_node_shell(struct ast *node)
+{
+    ast_free(node);
+}
 
 struct ast *program_node(struct ast *statement)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = PROGRAM;
     node->u.program = statement;
 
@@ -15,7 +127,7 @@ struct ast *program_node(struct ast *statement)
 
 struct ast *statement_node(struct ast *list, struct ast *statement)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = STATEMENT;
     node->u.statement.current = statement;
     node->u.statement.next = list;
@@ -25,7 +137,7 @@ struct ast *statement_node(struct ast *list, struct ast *statement)
 
 struct ast *int_node(uint64_t val)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = INT;
     node->u.number = val;
 
@@ -34,7 +146,7 @@ struct ast *int_node(uint64_t val)
 
 struct ast *float_node(double val)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = FLOAT;
     node->u.decimal = val;
 
@@ -43,7 +155,7 @@ struct ast *float_node(double val)
 
 struct ast *identifier_node(struct str ident)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = IDENTIFIER;
     node->u.identifier = ident;
 
@@ -52,7 +164,7 @@ struct ast *identifier_node(struct str ident)
 
 struct ast *string_node(struct str string)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = STRING;
     node->u.string = string;
 
@@ -61,7 +173,7 @@ struct ast *string_node(struct str string)
 
 struct ast *char_node(char ch)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = CHAR;
     node->u.ch = ch;
 
@@ -70,7 +182,7 @@ struct ast *char_node(char ch)
 
 struct ast *bool_node(short boolean)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = BOOL;
     node->u.boolean = boolean;
 
@@ -79,7 +191,7 @@ struct ast *bool_node(short boolean)
 
 struct ast *identifier_chain_node(struct ast *list, struct ast *ident)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = IDENTIFIER_CHAIN;
     node->u.identifier_chain.current = ident;
     node->u.identifier_chain.next = list;
@@ -89,7 +201,7 @@ struct ast *identifier_chain_node(struct ast *list, struct ast *ident)
 
 struct ast *operation_node(char *op, struct ast *left, struct ast *right)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = OPERATION;
     node->u.operation.op = op;
     node->u.operation.left = left;
@@ -100,7 +212,7 @@ struct ast *operation_node(char *op, struct ast *left, struct ast *right)
 
 struct ast *bracket_node(struct ast *expr)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = BRACKETS;
     node->u.bracket = expr;
 
@@ -109,7 +221,7 @@ struct ast *bracket_node(struct ast *expr)
 
 struct ast *var_decl_node(struct ast *type, struct ast *ident)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = VAR_DECL;
     node->u.variable_declaration.type = type;
     node->u.variable_declaration.identifier = ident;
@@ -119,7 +231,7 @@ struct ast *var_decl_node(struct ast *type, struct ast *ident)
 
 struct ast *var_def_node(struct ast *type, struct ast *ident, struct ast *val)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = VAR_DEF;
     node->u.variable_definition.type = type;
     node->u.variable_definition.identifier = ident;
@@ -130,7 +242,7 @@ struct ast *var_def_node(struct ast *type, struct ast *ident, struct ast *val)
 
 struct ast *fn_decl_node(struct ast *type, struct ast *ident, struct ast *args, bool immutable)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = FN_DECL;
     node->u.function_declaration.return_type = type;
     node->u.function_declaration.ident = ident;
@@ -143,7 +255,7 @@ struct ast *fn_def_node(struct ast *type, struct ast *ident, struct ast *args, s
 {
     if (body == NULL)
         return fn_decl_node(type, ident, args, immutable);
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = FN_DEF;
     node->u.function_definition.return_type = type;
     node->u.function_definition.ident = ident;
@@ -154,9 +266,36 @@ struct ast *fn_def_node(struct ast *type, struct ast *ident, struct ast *args, s
     return node;
 }
 
+unsigned fn_attribute(const char *name)
+{
+    static const struct { const char *name; unsigned attribute; } names[] = {
+        { "inline", FN_INLINE },
+        { "noinline", FN_NOINLINE },
+        { "hot", FN_HOT },
+        { "cold", FN_COLD },
+        { "export", FN_EXPORT },
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(*names); i++) {
+        if (strcmp(names[i].name, name) == 0)
+            return names[i].attribute;
+    }
+    return 0;
+}
+
+struct ast *annotate_fn_node(struct ast *fn, unsigned attributes)
+{
+    if (fn->type == FN_DECL)
+        fn->u.function_declaration.attributes = attributes;
+    else
+        fn->u.function_definition.attributes = attributes;
+
+    return fn;
+}
+
 struct ast *fn_call_node(struct ast *ident, struct ast *first_arg)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = FN_CALL;
     node->u.function_call.ident = ident;
     node->u.function_call.first_arg = first_arg;
@@ -166,7 +305,7 @@ struct ast *fn_call_node(struct ast *ident, struct ast *first_arg)
 
 struct ast *fn_arg_list_node(struct ast *list, struct ast *arg)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = FN_ARG;
     node->u.function_argument.next = list;
     node->u.function_argument.current = arg;
@@ -176,7 +315,7 @@ struct ast *fn_arg_list_node(struct ast *list, struct ast *arg)
 
 struct ast *type_node(struct ast *type)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = TYPE_NODE;
     node->u.type = type;
 
@@ -185,7 +324,7 @@ struct ast *type_node(struct ast *type)
 
 struct ast *pointer_node(struct ast *list, struct ast *type)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = POINTER;
     node->u.pointer.next = list;
     node->u.pointer.current = type;
@@ -195,7 +334,7 @@ struct ast *pointer_node(struct ast *list, struct ast *type)
 
 struct ast *if_node(struct ast *expr, struct ast *body, struct ast *next, bool unless)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = IF_COND;
     node->u.if_statement.expr = expr;
     node->u.if_statement.body = body;
@@ -206,7 +345,7 @@ struct ast *if_node(struct ast *expr, struct ast *body, struct ast *next, bool u
 }
 struct ast *expr_if_node(struct ast *expr, struct ast *condition, bool unless)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = EXPR_IF;
     node->u.expression_if.expr = expr;
     node->u.expression_if.condition = condition;
@@ -217,7 +356,7 @@ struct ast *expr_if_node(struct ast *expr, struct ast *condition, bool unless)
 
 struct ast *if_expr_node(struct ast *expr, struct ast *value, struct ast *else_value, bool unless)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = IF_EXPR;
     node->u.if_expression.expr = expr;
     node->u.if_expression.val = value;
@@ -229,7 +368,7 @@ struct ast *if_expr_node(struct ast *expr, struct ast *value, struct ast *else_v
 
 struct ast *elsif_node(struct ast *expr, struct ast *body, struct ast *next)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = ELSIF_COND;
     node->u.elsif_statement.expr = expr;
     node->u.elsif_statement.body = body;
@@ -240,7 +379,7 @@ struct ast *elsif_node(struct ast *expr, struct ast *body, struct ast *next)
 
 struct ast *else_node(struct ast *body)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = ELSE_COND;
     node->u.else_statement = body;
 
@@ -249,7 +388,7 @@ struct ast *else_node(struct ast *body)
 
 struct ast *unary_node(char *op, struct ast *val)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = UNARY;
     node->u.unary.op = op;
     node->u.unary.value = val;
@@ -259,7 +398,7 @@ struct ast *unary_node(char *op, struct ast *val)
 
 struct ast *for_node(struct ast *expr, struct ast *capture, struct ast *body)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = FOR;
     node->u.for_statement.expr = expr;
     node->u.for_statement.capture = capture;
@@ -270,7 +409,7 @@ struct ast *for_node(struct ast *expr, struct ast *capture, struct ast *body)
 
 struct ast *while_node(struct ast *expr, struct ast *body, bool do_while, bool until)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = WHILE;
     node->u.while_statement.expr = expr;
     node->u.while_statement.body = body;
@@ -282,7 +421,7 @@ struct ast *while_node(struct ast *expr, struct ast *body, bool do_while, bool u
 
 struct ast *field_access_node(struct ast *left, struct ast *right)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = FIELD_ACCESS;
     node->u.field_access.left = left;
     node->u.field_access.right = right;
@@ -291,7 +430,7 @@ struct ast *field_access_node(struct ast *left, struct ast *right)
 }
 struct ast *pointer_deref_node(struct ast *ptr)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = POINTER_DEREF;
     node->u.to_deref = ptr;
 
@@ -300,7 +439,7 @@ struct ast *pointer_deref_node(struct ast *ptr)
 
 struct ast *assign_node(char *op, struct ast *left, struct ast *right)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = ASSIGNMENT;
     node->u.assignment.op = op;
     node->u.assignment.left = left;
@@ -311,7 +450,7 @@ struct ast *assign_node(char *op, struct ast *left, struct ast *right)
 
 struct ast *type_cast_node(struct ast *expr, struct ast *type)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = TYPE_CAST;
     node->u.type_cast.expr = expr;
     node->u.type_cast.type = type;
@@ -321,7 +460,7 @@ struct ast *type_cast_node(struct ast *expr, struct ast *type)
 
 struct ast *break_node()
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = BREAK;
 
     return node;
@@ -329,7 +468,7 @@ struct ast *break_node()
 
 struct ast *next_node()
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = NEXT;
 
     return node;
@@ -337,23 +476,305 @@ struct ast *next_node()
 
 struct ast *variadic_node()
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = VARIADIC;
 
     return node;
 }
 
+struct ast_list statement_list_append(struct ast_list list, struct ast *statement)
+{
+    struct ast *node = statement_node(NULL, statement);
+
+    if (list.tail == NULL)
+        list.head = node;
+    else
+        list.tail->u.statement.next = node;
+    list.tail = node;
+
+    return list;
+}
+
+struct ast_list identifier_chain_append(struct ast_list list, struct ast *ident)
+{
+    struct ast *node = identifier_chain_node(NULL, ident);
+
+    if (list.tail == NULL)
+        list.head = node;
+    else
+        list.tail->u.identifier_chain.next = node;
+    list.tail = node;
+
+    return list;
+}
+
+struct ast_list fn_arg_list_append(struct ast_list list, struct ast *arg)
+{
+    struct ast *node = fn_arg_list_node(NULL, arg);
+
+    if (list.tail == NULL)
+        list.head = node;
+    else
+        list.tail->u.function_argument.next = node;
+    list.tail = node;
+
+    return list;
+}
+
 struct ast *dup_node(struct ast *n)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     *node = *n;
 
     return node;
 }
 
+static void _push(struct ast_stack *stack, struct ast *node)
+{
+    if (node == NULL)
+        return;
+
+    uint32_t it = ast_stack_push(stack);
+    stack_value(stack, it) = (struct ast_frame){ node, 0 };
+}
+
+/* argument defaults inside calls belong to the function signature and are skipped */
+static void _push_children(struct ast_stack *stack, struct ast *node)
+{
+    switch (node->type) {
+    case PROGRAM:
+        _push(stack, node->u.program);
+        break;
+    case STATEMENT:
+        _push(stack, node->u.statement.current);
+        _push(stack, node->u.statement.next);
+        break;
+    case BRACKETS:
+        _push(stack, node->u.bracket);
+        break;
+    case IDENTIFIER_CHAIN:
+        _push(stack, node->u.identifier_chain.current);
+        _push(stack, node->u.identifier_chain.next);
+        break;
+    case UNARY:
+        _push(stack, node->u.unary.value);
+        break;
+    case OPERATION:
+        _push(stack, node->u.operation.left);
+        _push(stack, node->u.operation.right);
+        break;
+    case VAR_DECL:
+        _push(stack, node->u.variable_declaration.type);
+        _push(stack, node->u.variable_declaration.identifier);
+        break;
+    case VAR_DEF:
+        _push(stack, node->u.variable_definition.type);
+        _push(stack, node->u.variable_definition.identifier);
+        _push(stack, node->u.variable_definition.value);
+        break;
+    case TYPE_NODE:
+        _push(stack, node->u.type);
+        break;
+    case POINTER:
+        _push(stack, node->u.pointer.current);
+        _push(stack, node->u.pointer.next);
+        break;
+    case FN_ARG:
+        _push(stack, node->u.function_argument.current);
+        _push(stack, node->u.function_argument.next);
+        break;
+    case FN_CALL:
+        _push(stack, node->u.function_call.ident);
+        _push(stack, node->u.function_call.first_arg);
+        break;
+    case IF_COND:
+        _push(stack, node->u.if_statement.expr);
+        _push(stack, node->u.if_statement.body);
+        _push(stack, node->u.if_statement.next);
+        break;
+    case IF_EXPR:
+        _push(stack, node->u.if_expression.expr);
+        _push(stack, node->u.if_expression.val);
+        _push(stack, node->u.if_expression.else_val);
+        break;
+    case EXPR_IF:
+        _push(stack, node->u.expression_if.expr);
+        _push(stack, node->u.expression_if.condition);
+        break;
+    case ELSIF_COND:
+        _push(stack, node->u.elsif_statement.expr);
+        _push(stack, node->u.elsif_statement.body);
+        _push(stack, node->u.elsif_statement.next);
+        break;
+    case ELSE_COND:
+        _push(stack, node->u.else_statement);
+        break;
+    case FOR:
+        _push(stack, node->u.for_statement.expr);
+        _push(stack, node->u.for_statement.capture);
+        _push(stack, node->u.for_statement.body);
+        break;
+    case WHILE:
+        _push(stack, node->u.while_statement.expr);
+        _push(stack, node->u.while_statement.body);
+        break;
+    case FIELD_ACCESS:
+        _push(stack, node->u.field_access.left);
+        _push(stack, node->u.field_access.right);
+        break;
+    case POINTER_DEREF:
+        _push(stack, node->u.to_deref);
+        break;
+    case ASSIGNMENT:
+        _push(stack, node->u.assignment.left);
+        _push(stack, node->u.assignment.right);
+        break;
+    case TYPE_CAST:
+        _push(stack, node->u.type_cast.expr);
+        _push(stack, node->u.type_cast.type);
+        break;
+    case BENCH:
+        _push(stack, node->u.bench.body);
+        break;
+    case ANALYZE_VALUE:
+        _push(stack, node->u.a_value.value);
+        break;
+    case ANALYZE_OPERATION:
+        _push(stack, node->u.a_operation.left);
+        _push(stack, node->u.a_operation.right);
+        break;
+    case ANALYZE_VAR:
+        _push(stack, node->u.a_var.value);
+        break;
+    case ANALYZE_FN_CALL:
+        for (size_t i = 0; i < node->u.a_fn_call.args_count; i++) {
+            struct analyzable_call_arg *arg = node->u.a_fn_call.args + i;
+            if (!arg->default_value)
+                _push(stack, arg->value);
+        }
+        break;
+    case ANALYZE_TYPE_CAST:
+        _push(stack, node->u.a_cast.value);
+        break;
+    case ANALYZE_IF:
+        _push(stack, node->u.a_if.expression);
+        _push(stack, node->u.a_if.body);
+        for (size_t i = 0; i < node->u.a_if.elsifs_count; i++) {
+            _push(stack, node->u.a_if.elsifs[i].expression);
+            _push(stack, node->u.a_if.elsifs[i].body);
+        }
+        _push(stack, node->u.a_if.else_op);
+        break;
+    case ANALYZE_FOR:
+        _push(stack, node->u.a_for.expr);
+        _push(stack, node->u.a_for.body);
+        break;
+    case ANALYZE_WHILE:
+        _push(stack, node->u.a_while.expr);
+        _push(stack, node->u.a_while.body);
+        break;
+    default:
+        /* leaves, and functions, whose bodies are reached through the function store */
+        break;
+    }
+}
+
+/* what a node owns besides its children */
+static void _free_fields(struct ast *node)
+{
+    switch (node->type) {
+    case IDENTIFIER:
+        ast_str_free(&node->u.identifier);
+        break;
+    case STRING:
+        ast_str_free(&node->u.string);
+        break;
+    case ANALYZE_VAR:
+        ast_str_free(&node->u.a_var.identifier);
+        break;
+    case ANALYZE_FN_CALL:
+        ast_free(node->u.a_fn_call.args);
+        ast_str_free(&node->u.a_fn_call.identifier);
+        break;
+    case ANALYZE_IF:
+        ast_free(node->u.a_if.elsifs);
+        break;
+    case ANALYZE_FOR:
+        for (size_t i = 0; i < node->u.a_for.payload_count; i++)
+            ast_str_free(&node->u.a_for.payloads[i].identifier);
+        ast_free(node->u.a_for.payloads);
+        break;
+    case IMPORT:
+        ast_str_free(&node->u.import);
+        break;
+    case BENCH:
+        ast_str_free(&node->u.bench.name);
+        break;
+    case ANALYZE_IMPORT:
+        ast_str_free(&node->u.a_import.module);
+        ast_free(node->u.a_import.functions);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Frees a parsed or analyzed subtree. Argument defaults inside calls belong
+ * to the function signature and are left alone, so are types, which live in
+ * the type store.
+ */
+void free_node(struct ast *root)
+{
+    struct ast_stack stack = {0};
+    _push(&stack, root);
+
+    while (stack.len > 0) {
+        struct ast *node = stack_value(&stack, stack_top(&stack)).node;
+        ast_stack_pop(&stack);
+
+        _push_children(&stack, node);
+        _free_fields(node);
+        free_node_shell(node);
+    }
+
+    ast_stack_free(&stack);
+}
+
+/* every node of a subtree, parents before their children */
+void walk_nodes(struct ast *root, void (*visit)(struct ast *node, void *data), void *data)
+{
+    struct ast_stack stack = {0};
+    _push(&stack, root);
+
+    while (stack.len > 0) {
+        struct ast *node = stack_value(&stack, stack_top(&stack)).node;
+        ast_stack_pop(&stack);
+
+        _push_children(&stack, node);
+        visit(node, data);
+    }
+
+    ast_stack_free(&stack);
+}
+
+static void _count(struct ast *node, void *data)
+{
+    (void)node;
+    (*(size_t *)data)++;
+}
+
+/* nodes in a subtree, a measure of how much C it turns into */
+size_t count_nodes(struct ast *root)
+{
+    size_t count = 0;
+    walk_nodes(root, _count, &count);
+    return count;
+}
+
 struct ast *range_node(int64_t start, int64_t end)
 {
-    struct ast *node = calloc(1, sizeof(*node));
+    struct ast *node = _new_node();
     node->type = RANGE;
     node->u.range.start = start;
     node->u.range.end = end;
@@ -361,6 +782,34 @@ struct ast *range_node(int64_t start, int64_t end)
     return node;
 }
 
+struct ast *lazy_body_node(struct source_range range)
+{
+    struct ast *node = _new_node();
+    node->type = LAZY_BODY;
+    node->u.lazy_body = range;
+
+    return node;
+}
+
+struct ast *import_node(struct str module)
+{
+    struct ast *node = _new_node();
+    node->type = IMPORT;
+    node->u.import = module;
+
+    return node;
+}
+
+struct ast *bench_node(struct str name, struct ast *body)
+{
+    struct ast *node = _new_node();
+    node->type = BENCH;
+    node->u.bench.name = name;
+    node->u.bench.body = body;
+
+    return node;
+}
+
 
 
 static void offset_text(int count)
@@ -379,8 +828,11 @@ static void print_a_type(struct analyzable_type t, int spacing)
     putchar('\n');
 }
 
+static void _describe_operation(struct ast *root, int spacing);
+
 static void _describe(struct ast *node, int spacing)
 {
+start:
     if (node == NULL) {
         offset_text(spacing);
         printf("nil\n");
@@ -404,14 +856,12 @@ static void _describe(struct ast *node, int spacing)
             printf("},\n");
         else
             printf("}\n");
-        _describe(node->u.statement.next, spacing);
-        break;
+        node = node->u.statement.next;
+        goto start;
     case BRACKETS:
-        offset_text(spacing);
-        printf("\e[32mBrackets\e[0m (\n");
-        _describe(node->u.bracket, spacing + 2);
-        offset_text(spacing);
-        printf(")\n");
+    case OPERATION:
+    case ANALYZE_OPERATION:
+        _describe_operation(node, spacing);
         break;
     case INT:
         offset_text(spacing);
@@ -437,14 +887,6 @@ static void _describe(struct ast *node, int spacing)
         offset_text(spacing);
         printf("\e[36mBool\e[0m: %s\n", node->u.boolean ? "true" : "false");
         break;
-    case OPERATION:
-        offset_text(spacing);
-        printf("\e[35mOperation\e[0m: %s {\n", node->u.operation.op);
-        _describe(node->u.operation.left, spacing + 2);
-        _describe(node->u.operation.right, spacing + 2);
-        offset_text(spacing);
-        printf("}\n");
-        break;
     case VAR_DECL:
         offset_text(spacing);
         printf("\e[34mVar Decl\e[0m {\n");
@@ -462,8 +904,8 @@ static void _describe(struct ast *node, int spacing)
             printf("},\n");
         else
             printf("}\n");
-        _describe(node->u.identifier_chain.next, spacing);
-        break;
+        node = node->u.identifier_chain.next;
+        goto start;
     case TYPE_NODE:
         offset_text(spacing);
         printf("\e[31mType\e[0m {\n");
@@ -522,8 +964,8 @@ spacing -= 2;
             printf("},\n");
         else
             printf("}\n");
-        _describe(node->u.function_argument.next, spacing);
-        break;
+        node = node->u.function_argument.next;
+        goto start;
     case FN_DEF:
         offset_text(spacing);
         printf("\e[34mFn Def\e[0m {\n");
@@ -696,15 +1138,6 @@ spacing -= 2;
         offset_text(spacing);
         printf("}\n");
         break;
-    case ANALYZE_OPERATION:
-        offset_text(spacing);
-        printf("\e[35mAnalyze Operation\e[0m: %s {\n", node->u.a_operation.operation);
-        _describe(node->u.a_operation.left, spacing + 2);
-        _describe(node->u.a_operation.right, spacing + 2);
-        print_a_type(node->u.a_operation.result_type, spacing + 2);
-        offset_text(spacing);
-        printf("}\n");
-        break;
     case ANALYZE_VAR:
         offset_text(spacing);
         printf("\e[34mAnalyze Var\e[0m {\n");
@@ -844,9 +1277,97 @@ spacing -= 2;
         offset_text(spacing);
         printf("\e[36mRange\e[0m: %ld..%ld\n", node->u.range.start, node->u.range.end);
         break;
+    case LAZY_BODY:
+        offset_text(spacing);
+        printf("\e[36mUnparsed\e[0m: %lu bytes at line %d\n", node->u.lazy_body.length, node->u.lazy_body.line);
+        break;
+    case IMPORT:
+        offset_text(spacing);
+        printf("\e[34mImport\e[0m: %s\n", node->u.import.str);
+        break;
+    case BENCH:
+        offset_text(spacing);
+        printf("\e[34mBench\e[0m: %s {\n", node->u.bench.name.str);
+        _describe(node->u.bench.body, spacing + 2);
+        offset_text(spacing);
+        printf("}\n");
+        break;
+    case ANALYZE_IMPORT:
+        offset_text(spacing);
+        printf("\e[34mAnalyze Import\e[0m: %s {\n", node->u.a_import.module.str);
+        for (size_t i = 0; i < node->u.a_import.functions_count; i++) {
+            offset_text(spacing + 2);
+            printf("Fn: %s,\n", node->u.a_import.functions[i].name.str);
+        }
+        offset_text(spacing);
+        printf("}\n");
+        break;
+    case ANALYZE_EMITTED:
+        offset_text(spacing);
+        printf("\e[36mEmitted\e[0m: %s\n", node->u.a_emitted.code.str);
+        break;
     }
 }
 
+/* operations nest as deep as the input does, walk them with a heap stack */
+static void _describe_operation(struct ast *root, int spacing)
+{
+    struct ast_stack stack = {0};
+    uint32_t it = ast_stack_push(&stack);
+    stack_value(&stack, it) = (struct ast_frame){ root, 0 };
+
+    while (stack.len > 0) {
+        it = stack_top(&stack);
+        struct ast_frame *frame = &stack_value(&stack, it);
+        struct ast *node = frame->node;
+        struct ast *child = NULL;
+        /* every nested operation is indented one level deeper */
+        int offset = spacing + 2 * it;
+
+        switch (frame->state++) {
+        case 0:
+            offset_text(offset);
+            if (node->type == BRACKETS) {
+                printf("\e[32mBrackets\e[0m (\n");
+                child = node->u.bracket;
+            } else if (node->type == OPERATION) {
+                printf("\e[35mOperation\e[0m: %s {\n", node->u.operation.op);
+                child = node->u.operation.left;
+            } else {
+                printf("\e[35mAnalyze Operation\e[0m: %s {\n", node->u.a_operation.operation);
+                child = node->u.a_operation.left;
+            }
+            break;
+        case 1:
+            if (node->type == OPERATION) {
+                child = node->u.operation.right;
+                break;
+            } else if (node->type == ANALYZE_OPERATION) {
+                child = node->u.a_operation.right;
+                break;
+            }
+            /* fallthrough */
+        default:
+            if (node->type == ANALYZE_OPERATION)
+                print_a_type(node->u.a_operation.result_type, offset + 2);
+            offset_text(offset);
+            printf(node->type == BRACKETS ? ")\n" : "}\n");
+            ast_stack_pop(&stack);
+            continue;
+        }
+
+        if (child != NULL && (child->type == BRACKETS || child->type == OPERATION
+                    || child->type == ANALYZE_OPERATION)) {
+            it = ast_stack_push(&stack);
+            stack_value(&stack, it) = (struct ast_frame){ child, 0 };
+        } else {
+            _describe(child, offset + 2);
+        }
+    }
+
+    ast_stack_free(&stack);
+}
+
 void describe(struct ast *node)
 {
     _describe(node, 0);
@@ -0,0 +1,599 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ast.h>
+#include <str.h>
+#include <str_builder.h>
+#include <cache.h>
+#include <lazy.h>
+#include <ast_cache.h>
+#include <diagnostic.h>
+#include <output.h>
+#include <hash/string_pool.h>
+
+#define AST_MAGIC "TZA"
+/* bump when the layout or the node types change */
+#define AST_VERSION 4
+/* trees are only read on machines with the byte order of the one that wrote them */
+#define AST_BYTE_ORDER 0x01020304
+
+/*
+ * A tree is this header, one record per node, a pool of interned NUL
+ * terminated strings and, for trees with lazy bodies, the source. Nodes are
+ * stored breadth first from the program down and refer to their children by
+ * record index plus one, so children always come after their parent.
+ */
+struct ast_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t nodes_count;
+    uint32_t strings_size;
+    uint32_t source_size;
+};
+
+struct ast_record {
+    uint32_t type;
+    /* the node's flags, the line of lazy bodies */
+    uint32_t flags;
+    uint32_t refs[4];
+    /* numbers, lazy body ranges and string offsets */
+    uint64_t values[2];
+    struct source_span span;
+};
+
+struct ast_writer {
+    struct ast **nodes;
+    struct ast_record *records;
+    uint32_t count;
+    uint32_t cap;
+    struct string_pool interned;
+    struct str_builder strings;
+    bool lazy;
+};
+
+struct ast_reader {
+    const struct ast_header *header;
+    const struct ast_record *records;
+    const char *strings;
+    struct ast **nodes;
+};
+
+static uint32_t _ref(struct ast_writer *w, struct ast *node)
+{
+    if (node == NULL)
+        return 0;
+
+    if (w->count == w->cap) {
+        w->cap = w->cap == 0 ? 64 : w->cap * 2;
+        w->nodes = realloc(w->nodes, w->cap * sizeof(*w->nodes));
+        w->records = realloc(w->records, w->cap * sizeof(*w->records));
+    }
+
+    w->nodes[w->count++] = node;
+    return w->count;
+}
+
+static uint64_t _intern(struct ast_writer *w, const char *s)
+{
+    uint32_t it = string_pool_find(&w->interned, s);
+    if (hash_exists(&w->interned, it))
+        return hash_value(&w->interned, it);
+
+    uint32_t offset = w->strings.buffer.size;
+    str_builder_append_cstr(&w->strings, s);
+    str_builder_append_char(&w->strings, '\0');
+
+    /* the tree outlives the writer, so its strings can be the keys */
+    it = string_pool_insert(&w->interned, s);
+    hash_value(&w->interned, it) = offset;
+    return offset;
+}
+
+static struct ast_record _encode(struct ast_writer *w, struct ast *node)
+{
+    struct ast_record r = { .type = node->type, .span = node->span };
+
+    switch (node->type) {
+    case PROGRAM:
+        r.refs[0] = _ref(w, node->u.program);
+        break;
+    case STATEMENT:
+        r.refs[0] = _ref(w, node->u.statement.current);
+        r.refs[1] = _ref(w, node->u.statement.next);
+        break;
+    case BRACKETS:
+        r.refs[0] = _ref(w, node->u.bracket);
+        break;
+    case INT:
+        r.values[0] = node->u.number;
+        break;
+    case FLOAT:
+        memcpy(r.values, &node->u.decimal, sizeof(node->u.decimal));
+        break;
+    case IDENTIFIER:
+        r.values[0] = _intern(w, node->u.identifier.str);
+        break;
+    case CHAR:
+        r.values[0] = (uint8_t)node->u.ch;
+        break;
+    case BOOL:
+        r.flags = node->u.boolean;
+        break;
+    case STRING:
+        r.values[0] = _intern(w, node->u.string.str);
+        break;
+    case IDENTIFIER_CHAIN:
+        r.refs[0] = _ref(w, node->u.identifier_chain.current);
+        r.refs[1] = _ref(w, node->u.identifier_chain.next);
+        break;
+    case UNARY:
+        r.values[0] = _intern(w, node->u.unary.op);
+        r.refs[0] = _ref(w, node->u.unary.value);
+        break;
+    case OPERATION:
+        r.values[0] = _intern(w, node->u.operation.op);
+        r.refs[0] = _ref(w, node->u.operation.left);
+        r.refs[1] = _ref(w, node->u.operation.right);
+        break;
+    case VAR_DECL:
+        r.refs[0] = _ref(w, node->u.variable_declaration.type);
+        r.refs[1] = _ref(w, node->u.variable_declaration.identifier);
+        break;
+    case VAR_DEF:
+        r.refs[0] = _ref(w, node->u.variable_definition.type);
+        r.refs[1] = _ref(w, node->u.variable_definition.identifier);
+        r.refs[2] = _ref(w, node->u.variable_definition.value);
+        break;
+    case TYPE_NODE:
+        r.refs[0] = _ref(w, node->u.type);
+        break;
+    case POINTER:
+        r.refs[0] = _ref(w, node->u.pointer.current);
+        r.refs[1] = _ref(w, node->u.pointer.next);
+        break;
+    case FN_DECL:
+        r.flags = node->u.function_declaration.immutable;
+        r.values[0] = node->u.function_declaration.attributes;
+        r.refs[0] = _ref(w, node->u.function_declaration.return_type);
+        r.refs[1] = _ref(w, node->u.function_declaration.ident);
+        r.refs[2] = _ref(w, node->u.function_declaration.arg_list);
+        break;
+    case FN_DEF:
+        r.flags = node->u.function_definition.immutable;
+        r.values[0] = node->u.function_definition.attributes;
+        r.refs[0] = _ref(w, node->u.function_definition.return_type);
+        r.refs[1] = _ref(w, node->u.function_definition.ident);
+        r.refs[2] = _ref(w, node->u.function_definition.arg_list);
+        r.refs[3] = _ref(w, node->u.function_definition.body);
+        break;
+    case FN_ARG:
+        r.refs[0] = _ref(w, node->u.function_argument.current);
+        r.refs[1] = _ref(w, node->u.function_argument.next);
+        break;
+    case FN_CALL:
+        r.refs[0] = _ref(w, node->u.function_call.ident);
+        r.refs[1] = _ref(w, node->u.function_call.first_arg);
+        break;
+    case IF_COND:
+        r.flags = node->u.if_statement.unless;
+        r.refs[0] = _ref(w, node->u.if_statement.expr);
+        r.refs[1] = _ref(w, node->u.if_statement.body);
+        r.refs[2] = _ref(w, node->u.if_statement.next);
+        break;
+    case IF_EXPR:
+        r.flags = node->u.if_expression.unless;
+        r.refs[0] = _ref(w, node->u.if_expression.expr);
+        r.refs[1] = _ref(w, node->u.if_expression.val);
+        r.refs[2] = _ref(w, node->u.if_expression.else_val);
+        break;
+    case EXPR_IF:
+        r.flags = node->u.expression_if.unless;
+        r.refs[0] = _ref(w, node->u.expression_if.expr);
+        r.refs[1] = _ref(w, node->u.expression_if.condition);
+        break;
+    case ELSIF_COND:
+        r.refs[0] = _ref(w, node->u.elsif_statement.expr);
+        r.refs[1] = _ref(w, node->u.elsif_statement.body);
+        r.refs[2] = _ref(w, node->u.elsif_statement.next);
+        break;
+    case ELSE_COND:
+        r.refs[0] = _ref(w, node->u.else_statement);
+        break;
+    case FOR:
+        r.refs[0] = _ref(w, node->u.for_statement.expr);
+        r.refs[1] = _ref(w, node->u.for_statement.capture);
+        r.refs[2] = _ref(w, node->u.for_statement.body);
+        break;
+    case WHILE:
+        r.flags = node->u.while_statement.do_while | node->u.while_statement.until << 1;
+        r.refs[0] = _ref(w, node->u.while_statement.expr);
+        r.refs[1] = _ref(w, node->u.while_statement.body);
+        break;
+    case FIELD_ACCESS:
+        r.refs[0] = _ref(w, node->u.field_access.left);
+        r.refs[1] = _ref(w, node->u.field_access.right);
+        break;
+    case POINTER_DEREF:
+        r.refs[0] = _ref(w, node->u.to_deref);
+        break;
+    case ASSIGNMENT:
+        r.values[0] = _intern(w, node->u.assignment.op);
+        r.refs[0] = _ref(w, node->u.assignment.left);
+        r.refs[1] = _ref(w, node->u.assignment.right);
+        break;
+    case TYPE_CAST:
+        r.refs[0] = _ref(w, node->u.type_cast.expr);
+        r.refs[1] = _ref(w, node->u.type_cast.type);
+        break;
+    case NEXT:
+    case BREAK:
+    case VARIADIC:
+        break;
+    case RANGE:
+        r.values[0] = node->u.range.start;
+        r.values[1] = node->u.range.end;
+        break;
+    case LAZY_BODY:
+        w->lazy = true;
+        r.flags = node->u.lazy_body.line;
+        r.values[0] = node->u.lazy_body.offset;
+        r.values[1] = node->u.lazy_body.length;
+        break;
+    case IMPORT:
+        r.values[0] = _intern(w, node->u.import.str);
+        break;
+    case BENCH:
+        r.refs[0] = _ref(w, node->u.bench.body);
+        r.values[0] = _intern(w, node->u.bench.name.str);
+        break;
+    default:
+        fatal("only parsed trees can be written, got %d!", node->type);
+    }
+
+    return r;
+}
+
+bool ast_write(struct ast *program, const char *path)
+{
+    struct ast_writer w = {0};
+
+    /* breadth first, so deep trees don't need a deep stack */
+    _ref(&w, program);
+    for (uint32_t i = 0; i < w.count; i++) {
+        struct ast_record r = _encode(&w, w.nodes[i]);
+        w.records[i] = r;
+    }
+
+    struct str source = w.lazy ? parse_source() : (struct str){0};
+    struct ast_header header = {
+        .magic = AST_MAGIC,
+        .version = AST_VERSION,
+        .byte_order = AST_BYTE_ORDER,
+        .nodes_count = w.count,
+        .strings_size = w.strings.buffer.size,
+        .source_size = source.size,
+    };
+
+    bool written = false;
+    struct str_builder b = {0};
+    str_builder_printf(&b, "%s.%ld.tmp", path, (long)getpid());
+    struct str tmp_path = str_builder_str(&b);
+
+    /* offsets are 32 bits wide, bigger inputs are just parsed every time */
+    FILE *f = NULL;
+    if (source.size <= UINT32_MAX && w.strings.buffer.size <= UINT32_MAX)
+        f = fopen(tmp_path.str, "wb");
+
+    if (f != NULL) {
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(w.records, sizeof(*w.records), w.count, f);
+        if (w.strings.buffer.size > 0)
+            fwrite(w.strings.buffer.str, 1, w.strings.buffer.size, f);
+        if (source.size > 0)
+            fwrite(source.str, 1, source.size, f);
+
+        bool failed = ferror(f);
+        written = fclose(f) == 0 && !failed && output_commit(tmp_path.str, path);
+    }
+
+    if (!written) {
+        fprintf(stderr, "unable to write tree %s: %s\n", path, strerror(errno));
+        remove(tmp_path.str);
+    }
+
+    str_free(&tmp_path);
+    str_builder_deinit(&w.strings);
+    string_pool_free(&w.interned);
+    free(w.nodes);
+    free(w.records);
+    return written;
+}
+
+static bool _valid(struct ast_reader *rd, size_t size)
+{
+    const struct ast_header *h = rd->header;
+
+    if (size < sizeof(*h) || memcmp(h->magic, AST_MAGIC, sizeof(h->magic)) != 0
+            || h->version != AST_VERSION || h->byte_order != AST_BYTE_ORDER || h->nodes_count == 0)
+        return false;
+
+    uint64_t expected = sizeof(*h) + (uint64_t)h->nodes_count * sizeof(struct ast_record)
+        + h->strings_size + h->source_size;
+    if (expected != size)
+        return false;
+
+    rd->records = (const struct ast_record *)(h + 1);
+    rd->strings = (const char *)(rd->records + h->nodes_count);
+    if (h->strings_size > 0 && rd->strings[h->strings_size - 1] != '\0')
+        return false;
+
+    if (rd->records[0].type != PROGRAM)
+        return false;
+
+    /* every node has one parent that comes before it, so the records are a tree */
+    uint8_t *seen = calloc(h->nodes_count, 1);
+    bool valid = true;
+    for (uint32_t i = 0; valid && i < h->nodes_count; i++) {
+        const struct ast_record *r = rd->records + i;
+
+        for (int j = 0; valid && j < 4; j++) {
+            uint32_t ref = r->refs[j];
+            if (ref == 0)
+                continue;
+            valid = ref - 1 > i && ref <= h->nodes_count && !seen[ref - 1];
+            if (valid)
+                seen[ref - 1] = 1;
+        }
+
+        switch (r->type) {
+        case IDENTIFIER:
+        case STRING:
+        case UNARY:
+        case OPERATION:
+        case ASSIGNMENT:
+        case IMPORT:
+        case BENCH:
+            valid = valid && r->values[0] < h->strings_size;
+            break;
+        case LAZY_BODY:
+            valid = valid && r->values[0] <= h->source_size && r->values[1] <= h->source_size - r->values[0];
+            break;
+        default:
+            valid = valid && r->type < LAZY_BODY;
+            break;
+        }
+    }
+    free(seen);
+
+    return valid;
+}
+
+static struct ast *_node(struct ast_reader *rd, uint32_t ref)
+{
+    return ref == 0 ? NULL : rd->nodes[ref - 1];
+}
+
+/* the tree owns its strings, operators are left pointing into the mapping */
+static struct str _read_string(struct ast_reader *rd, uint64_t offset)
+{
+    const char *s = rd->strings + offset;
+    return str_init(s, strlen(s));
+}
+
+static void _decode(struct ast_reader *rd, const struct ast_record *r, struct ast *node)
+{
+    node->type = r->type;
+    node->span = r->span;
+
+    switch (node->type) {
+    case PROGRAM:
+        node->u.program = _node(rd, r->refs[0]);
+        break;
+    case STATEMENT:
+        node->u.statement.current = _node(rd, r->refs[0]);
+        node->u.statement.next = _node(rd, r->refs[1]);
+        break;
+    case BRACKETS:
+        node->u.bracket = _node(rd, r->refs[0]);
+        break;
+    case INT:
+        node->u.number = r->values[0];
+        break;
+    case FLOAT:
+        memcpy(&node->u.decimal, r->values, sizeof(node->u.decimal));
+        break;
+    case IDENTIFIER:
+        node->u.identifier = _read_string(rd, r->values[0]);
+        break;
+    case CHAR:
+        node->u.ch = r->values[0];
+        break;
+    case BOOL:
+        node->u.boolean = r->flags;
+        break;
+    case STRING:
+        node->u.string = _read_string(rd, r->values[0]);
+        break;
+    case IDENTIFIER_CHAIN:
+        node->u.identifier_chain.current = _node(rd, r->refs[0]);
+        node->u.identifier_chain.next = _node(rd, r->refs[1]);
+        break;
+    case UNARY:
+        node->u.unary.op = (char *)rd->strings + r->values[0];
+        node->u.unary.value = _node(rd, r->refs[0]);
+        break;
+    case OPERATION:
+        node->u.operation.op = (char *)rd->strings + r->values[0];
+        node->u.operation.left = _node(rd, r->refs[0]);
+        node->u.operation.right = _node(rd, r->refs[1]);
+        break;
+    case VAR_DECL:
+        node->u.variable_declaration.type = _node(rd, r->refs[0]);
+        node->u.variable_declaration.identifier = _node(rd, r->refs[1]);
+        break;
+    case VAR_DEF:
+        node->u.variable_definition.type = _node(rd, r->refs[0]);
+        node->u.variable_definition.identifier = _node(rd, r->refs[1]);
+        node->u.variable_definition.value = _node(rd, r->refs[2]);
+        break;
+    case TYPE_NODE:
+        node->u.type = _node(rd, r->refs[0]);
+        break;
+    case POINTER:
+        node->u.pointer.current = _node(rd, r->refs[0]);
+        node->u.pointer.next = _node(rd, r->refs[1]);
+        break;
+    case FN_DECL:
+        node->u.function_declaration.immutable = r->flags;
+        node->u.function_declaration.attributes = r->values[0];
+        node->u.function_declaration.return_type = _node(rd, r->refs[0]);
+        node->u.function_declaration.ident = _node(rd, r->refs[1]);
+        node->u.function_declaration.arg_list = _node(rd, r->refs[2]);
+        break;
+    case FN_DEF:
+        node->u.function_definition.immutable = r->flags;
+        node->u.function_definition.attributes = r->values[0];
+        node->u.function_definition.return_type = _node(rd, r->refs[0]);
+        node->u.function_definition.ident = _node(rd, r->refs[1]);
+        node->u.function_definition.arg_list = _node(rd, r->refs[2]);
+        node->u.function_definition.body = _node(rd, r->refs[3]);
+        break;
+    case FN_ARG:
+        node->u.function_argument.current = _node(rd, r->refs[0]);
+        node->u.function_argument.next = _node(rd, r->refs[1]);
+        break;
+    case FN_CALL:
+        node->u.function_call.ident = _node(rd, r->refs[0]);
+        node->u.function_call.first_arg = _node(rd, r->refs[1]);
+        break;
+    case IF_COND:
+        node->u.if_statement.unless = r->flags;
+        node->u.if_statement.expr = _node(rd, r->refs[0]);
+        node->u.if_statement.body = _node(rd, r->refs[1]);
+        node->u.if_statement.next = _node(rd, r->refs[2]);
+        break;
+    case IF_EXPR:
+        node->u.if_expression.unless = r->flags;
+        node->u.if_expression.expr = _node(rd, r->refs[0]);
+        node->u.if_expression.val = _node(rd, r->refs[1]);
+        node->u.if_expression.else_val = _node(rd, r->refs[2]);
+        break;
+    case EXPR_IF:
+        node->u.expression_if.unless = r->flags;
+        node->u.expression_if.expr = _node(rd, r->refs[0]);
+        node->u.expression_if.condition = _node(rd, r->refs[1]);
+        break;
+    case ELSIF_COND:
+        node->u.elsif_statement.expr = _node(rd, r->refs[0]);
+        node->u.elsif_statement.body = _node(rd, r->refs[1]);
+        node->u.elsif_statement.next = _node(rd, r->refs[2]);
+        break;
+    case ELSE_COND:
+        node->u.else_statement = _node(rd, r->refs[0]);
+        break;
+    case FOR:
+        node->u.for_statement.expr = _node(rd, r->refs[0]);
+        node->u.for_statement.capture = _node(rd, r->refs[1]);
+        node->u.for_statement.body = _node(rd, r->refs[2]);
+        break;
+    case WHILE:
+        node->u.while_statement.do_while = r->flags & 1;
+        node->u.while_statement.until = r->flags >> 1 & 1;
+        node->u.while_statement.expr = _node(rd, r->refs[0]);
+        node->u.while_statement.body = _node(rd, r->refs[1]);
+        break;
+    case FIELD_ACCESS:
+        node->u.field_access.left = _node(rd, r->refs[0]);
+        node->u.field_access.right = _node(rd, r->refs[1]);
+        break;
+    case POINTER_DEREF:
+        node->u.to_deref = _node(rd, r->refs[0]);
+        break;
+    case ASSIGNMENT:
+        node->u.assignment.op = (char *)rd->strings + r->values[0];
+        node->u.assignment.left = _node(rd, r->refs[0]);
+        node->u.assignment.right = _node(rd, r->refs[1]);
+        break;
+    case TYPE_CAST:
+        node->u.type_cast.expr = _node(rd, r->refs[0]);
+        node->u.type_cast.type = _node(rd, r->refs[1]);
+        break;
+    case RANGE:
+        node->u.range.start = r->values[0];
+        node->u.range.end = r->values[1];
+        break;
+    case LAZY_BODY:
+        node->u.lazy_body.line = r->flags;
+        node->u.lazy_body.offset = r->values[0];
+        node->u.lazy_body.length = r->values[1];
+        break;
+    case IMPORT:
+        node->u.import = _read_string(rd, r->values[0]);
+        break;
+    case BENCH:
+        node->u.bench.body = _node(rd, r->refs[0]);
+        node->u.bench.name = _read_string(rd, r->values[0]);
+        break;
+    default:
+        break;
+    }
+}
+
+/* operators and lazy bodies point into the mapping, so it stays mapped until the compiler exits */
+struct ast *ast_read(const char *path)
+{
+    struct ast_reader rd = {0};
+    struct stat st;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(*rd.header))
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    rd.header = data;
+    if (data == MAP_FAILED || !_valid(&rd, st.st_size)) {
+        fprintf(stderr, "tree %s is corrupt or from another version, not using it\n", path);
+        if (data != MAP_FAILED)
+            munmap(data, st.st_size);
+        return NULL;
+    }
+
+    uint32_t count = rd.header->nodes_count;
+    rd.nodes = malloc(count * sizeof(*rd.nodes));
+    for (uint32_t i = 0; i < count; i++)
+        rd.nodes[i] = calloc(1, sizeof(struct ast));
+    for (uint32_t i = 0; i < count; i++)
+        _decode(&rd, rd.records + i, rd.nodes[i]);
+
+    if (rd.header->source_size > 0) {
+        const char *source = rd.strings + rd.header->strings_size;
+        parse_use_source((struct str){ (char *)source, rd.header->source_size });
+    }
+
+    struct ast *program = rd.nodes[0];
+    free(rd.nodes);
+    return program;
+}
+
+struct str ast_cache_path(const char *dir, struct str source)
+{
+    char key[CACHE_KEY_SIZE];
+    struct str_builder b = {0};
+
+    /* lazy bodies are the only option that changes the parsed tree */
+    cache_key(key, lazy_bodies ? "ast lazy" : "ast", source.str, source.size);
+    str_builder_printf(&b, "%s/%s.ast", dir, key);
+    return str_builder_str(&b);
+}
@@ -0,0 +1,107 @@
+#include <bench.h>
+
+/*
+ * libc is reached under names of its own, the program may declare these
+ * differently or not at all. Without time.h the clock is the number of the
+ * systems the generated C is built on.
+ */
+const char bench_runtime[] =
+    "#define tz_bench_str2(x) #x\n"
+    "#define tz_bench_str(x) tz_bench_str2(x)\n"
+    "#define tz_bench_symbol(name) __asm__(tz_bench_str(__USER_LABEL_PREFIX__) name)\n"
+    "#if defined(__APPLE__)\n"
+    "#define TZ_BENCH_CLOCK 6\n"
+    "#elif defined(__FreeBSD__)\n"
+    "#define TZ_BENCH_CLOCK 4\n"
+    "#else\n"
+    "#define TZ_BENCH_CLOCK 1\n"
+    "#endif\n"
+    "struct tz_bench_time {\n"
+    "long sec;\n"
+    "long nsec;\n"
+    "};\n"
+    "extern int tz_bench_clock_gettime(int, struct tz_bench_time *) tz_bench_symbol(\"clock_gettime\");\n"
+    "extern int tz_bench_printf(const char *, ...) tz_bench_symbol(\"printf\");\n"
+    "extern char *tz_bench_strstr(const char *, const char *) tz_bench_symbol(\"strstr\");\n"
+    "extern void tz_bench_qsort(void *, unsigned long, unsigned long, int (*)(const void *, const void *)) tz_bench_symbol(\"qsort\");\n"
+    "\n"
+    "struct tz_bench {\n"
+    "const char *name;\n"
+    "void (*run)(void);\n"
+    "};\n"
+    "\n"
+    "/* the value escapes into memory the compiler can't see through, so neither it nor what it came from is dropped */\n"
+    "#define tz_bench_keep(x) do { __typeof__(x) tz_bench_kept = (x); __asm__ volatile(\"\" : : \"r\"(&tz_bench_kept) : \"memory\"); } while (0)\n"
+    "\n"
+    "/* the program's own main is left as it is, the harness takes its name */\n"
+    "#define main tz_bench_program_main\n";
+
+/*
+ * Each sample times a batch of calls, the clock only has to be good to a
+ * small part of the batch, and the function pointer adds one call to each.
+ */
+const char bench_main[] =
+    "#undef main\n"
+    "#define TZ_BENCH_WARMUP_NS 100000000ull\n"
+    "#define TZ_BENCH_BATCH_NS 1000000ull\n"
+    "#define TZ_BENCH_TIME_NS 1000000000ull\n"
+    "#define TZ_BENCH_SAMPLES 101\n"
+    "#define TZ_BENCH_MIN_SAMPLES 11\n"
+    "\n"
+    "static u64 tz_bench_now(void)\n"
+    "{\n"
+    "struct tz_bench_time t;\n"
+    "tz_bench_clock_gettime(TZ_BENCH_CLOCK, &t);\n"
+    "return (u64)t.sec * 1000000000ull + (u64)t.nsec;\n"
+    "}\n"
+    "\n"
+    "/* one sample times a batch, so reading the clock costs nothing next to it */\n"
+    "static u64 tz_bench_batch(void (*run)(void), u64 iterations)\n"
+    "{\n"
+    "u64 start = tz_bench_now();\n"
+    "for (u64 i = 0; i < iterations; i++)\n"
+    "run();\n"
+    "return tz_bench_now() - start;\n"
+    "}\n"
+    "\n"
+    "static int tz_bench_compare(const void *a, const void *b)\n"
+    "{\n"
+    "double l = *(const double *)a, r = *(const double *)b;\n"
+    "return (l > r) - (l < r);\n"
+    "}\n"
+    "\n"
+    "static void tz_bench_measure(const struct tz_bench *b)\n"
+    "{\n"
+    "/* warms caches and branch predictors up, and doubles the iterations until a batch takes long enough */\n"
+    "u64 iterations = 1;\n"
+    "u64 warm = tz_bench_now() + TZ_BENCH_WARMUP_NS;\n"
+    "for (;;) {\n"
+    "u64 ns = tz_bench_batch(b->run, iterations);\n"
+    "if (ns < TZ_BENCH_BATCH_NS && iterations < (1ull << 62))\n"
+    "iterations *= 2;\n"
+    "else if (tz_bench_now() >= warm)\n"
+    "break;\n"
+    "}\n"
+    "\n"
+    "double samples[TZ_BENCH_SAMPLES];\n"
+    "int count = 0;\n"
+    "u64 end = tz_bench_now() + TZ_BENCH_TIME_NS;\n"
+    "while (count < TZ_BENCH_SAMPLES && (count < TZ_BENCH_MIN_SAMPLES || tz_bench_now() < end))\n"
+    "samples[count++] = (double)tz_bench_batch(b->run, iterations) / (double)iterations;\n"
+    "tz_bench_qsort(samples, count, sizeof(*samples), tz_bench_compare);\n"
+    "\n"
+    "double median = samples[count / 2];\n"
+    "double p99 = samples[(count * 99 + 99) / 100 - 1];\n"
+    "tz_bench_printf(\"%-32s %12.2f ns/op median %12.2f ns/op p99 %14.0f ops/s  %llu x %d\\n\", b->name, median, p99,\n"
+    "median > 0 ? 1e9 / median : 0.0, (unsigned long long)iterations, count);\n"
+    "}\n"
+    "\n"
+    "/* runs every bench, or the ones whose names contain the first argument */\n"
+    "int main(int argc, char **argv)\n"
+    "{\n"
+    "for (const struct tz_bench *b = tz_benches; b->name != 0; b++) {\n"
+    "if (argc < 2 || tz_bench_strstr(b->name, argv[1]) != 0)\n"
+    "tz_bench_measure(b);\n"
+    "}\n"
+    "return 0;\n"
+    "}\n";
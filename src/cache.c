@@ -0,0 +1,111 @@
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <str.h>
+#include <str_builder.h>
+#include <sha256.h>
+#include <cache.h>
+
+/* bump when the layout of entries or the generated C changes */
+#define CACHE_FORMAT "tanzanite-cache-2"
+
+static void _copy(FILE *from, FILE *to)
+{
+    char buffer[1 << 16];
+    size_t read = 0;
+
+    while ((read = fread(buffer, 1, sizeof(buffer), from)) > 0)
+        fwrite(buffer, 1, read, to);
+}
+
+/* NUL separated so no two sets of inputs hash the same bytes */
+void cache_key(char key[CACHE_KEY_SIZE], const char *options, const void *data, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *parts[] = { CACHE_FORMAT, PACKAGE_VERSION, CONFIGURE_ARGS, options };
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    struct sha256 sha;
+
+    sha256_init(&sha);
+    for (size_t i = 0; i < sizeof(parts) / sizeof(*parts); i++)
+        sha256_update(&sha, parts[i], strlen(parts[i]) + 1);
+    sha256_update(&sha, data, size);
+    sha256_final(&sha, digest);
+
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        key[i * 2] = hex[digest[i] >> 4];
+        key[i * 2 + 1] = hex[digest[i] & 0xf];
+    }
+    key[SHA256_DIGEST_SIZE * 2] = '\0';
+}
+
+bool cache_init(struct cache *cache, const char *dir, const char *options, struct str source)
+{
+    memset(cache, 0, sizeof(*cache));
+
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "cache directory %s: %s, not caching\n", dir, strerror(errno));
+        return false;
+    }
+
+    cache_key(cache->key, options, source.str, source.size);
+
+    struct str_builder b = {0};
+    str_builder_printf(&b, "%s/%s.c", dir, cache->key);
+    cache->path = str_builder_str(&b);
+
+    b = (struct str_builder){0};
+    str_builder_printf(&b, "%s/%s.c.%ld.tmp", dir, cache->key, (long)getpid());
+    cache->tmp_path = str_builder_str(&b);
+
+    return true;
+}
+
+bool cache_fetch(struct cache *cache, FILE *out)
+{
+    FILE *entry = fopen(cache->path.str, "rb");
+    if (entry == NULL)
+        return false;
+
+    _copy(entry, out);
+    fclose(entry);
+    return true;
+}
+
+/* entries are written under a temporary name, so readers never see half of one */
+FILE *cache_create(struct cache *cache)
+{
+    FILE *entry = fopen(cache->tmp_path.str, "w+b");
+    if (entry == NULL)
+        fprintf(stderr, "cache entry %s: %s, not caching\n", cache->tmp_path.str, strerror(errno));
+
+    return entry;
+}
+
+/* out, when given, also gets everything that was written to the entry */
+void cache_commit(struct cache *cache, FILE *entry, FILE *out)
+{
+    bool failed = fflush(entry) != 0 || ferror(entry);
+
+    if (out != NULL) {
+        rewind(entry);
+        _copy(entry, out);
+    }
+
+    if (fclose(entry) != 0 || failed || rename(cache->tmp_path.str, cache->path.str) != 0) {
+        fprintf(stderr, "cache entry %s: %s, not caching\n", cache->path.str, strerror(errno));
+        remove(cache->tmp_path.str);
+    }
+}
+
+void cache_deinit(struct cache *cache)
+{
+    str_free(&cache->path);
+    str_free(&cache->tmp_path);
+}
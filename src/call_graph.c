@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <ast.h>
+#include <call_graph.h>
+
+struct walk {
+    struct call_graph *g;
+    size_t caller;
+};
+
+static void _add(size_t **list, size_t *count, size_t value)
+{
+    for (size_t i = 0; i < *count; i++) {
+        if ((*list)[i] == value)
+            return;
+    }
+
+    *list = realloc(*list, (*count + 1) * sizeof(**list));
+    (*list)[(*count)++] = value;
+}
+
+static void _visit(struct ast *node, void *data)
+{
+    struct walk *w = data;
+    if (node->type != ANALYZE_FN_CALL)
+        return;
+
+    struct call_graph_node *caller = w->g->nodes + w->caller;
+    size_t callee = call_graph_find(w->g, node->u.a_fn_call.identifier.str);
+    if (callee == w->g->count) {
+        caller->external_calls++;
+        return;
+    }
+
+    _add(&caller->callees, &caller->callees_count, callee);
+    _add(&w->g->nodes[callee].callers, &w->g->nodes[callee].callers_count, w->caller);
+}
+
+/* a body that is still unparsed was never reached and is never emitted */
+static bool _has_body(struct ast *stmt)
+{
+    return stmt->type == ANALYZE_FN && !stmt->u.a_fn.declaration && stmt->u.a_fn.body != NULL
+        && stmt->u.a_fn.body->type != LAZY_BODY;
+}
+
+void call_graph_build(struct call_graph *g, struct ast *program)
+{
+    memset(g, 0, sizeof(*g));
+
+    for (struct ast *iter = program->u.program; iter != NULL; iter = iter->u.statement.next) {
+        struct ast *stmt = iter->u.statement.current;
+        if (!_has_body(stmt))
+            continue;
+
+        g->nodes = realloc(g->nodes, (g->count + 1) * sizeof(*g->nodes));
+        g->nodes[g->count] = (struct call_graph_node){ .fn = stmt };
+        uint32_t it = function_index_insert(&g->index, stmt->u.a_fn.name.str);
+        hash_value(&g->index, it) = g->count++;
+    }
+
+    for (size_t i = 0; i < g->count; i++) {
+        struct walk w = { g, i };
+        walk_nodes(g->nodes[i].fn->u.a_fn.body, _visit, &w);
+    }
+}
+
+size_t call_graph_find(struct call_graph *g, const char *name)
+{
+    uint32_t it = function_index_find(&g->index, name);
+    return hash_exists(&g->index, it) ? hash_value(&g->index, it) : g->count;
+}
+
+/* depth first from every function in source order, a function is placed once all its callees are */
+size_t *call_graph_order(struct call_graph *g)
+{
+    size_t *order = calloc(g->count, sizeof(*order));
+    size_t placed = 0;
+    bool *seen = calloc(g->count, sizeof(*seen));
+    /* the call chains can be as long as the program, so the walk keeps its own stack */
+    size_t *stack = calloc(g->count, sizeof(*stack));
+    size_t *next = calloc(g->count, sizeof(*next));
+
+    for (size_t root = 0; root < g->count; root++) {
+        if (seen[root])
+            continue;
+
+        size_t depth = 0;
+        seen[root] = true;
+        stack[depth++] = root;
+        while (depth > 0) {
+            size_t top = stack[depth - 1];
+            struct call_graph_node *node = g->nodes + top;
+
+            if (next[top] < node->callees_count) {
+                size_t callee = node->callees[next[top]++];
+                if (!seen[callee]) {
+                    seen[callee] = true;
+                    stack[depth++] = callee;
+                }
+                continue;
+            }
+
+            order[placed++] = top;
+            depth--;
+        }
+    }
+
+    free(next);
+    free(stack);
+    free(seen);
+    return order;
+}
+
+/*
+ * Tarjan's strongly connected components, with the same explicit stack as
+ * the order. A component of more than one function is a cycle, a single one
+ * only when it calls itself.
+ */
+bool *call_graph_recursive(struct call_graph *g)
+{
+    bool *recursive = calloc(g->count, sizeof(*recursive));
+    /* 0 until visited */
+    size_t *index = calloc(g->count, sizeof(*index));
+    size_t *low = calloc(g->count, sizeof(*low));
+    bool *open = calloc(g->count, sizeof(*open));
+    size_t *component = calloc(g->count, sizeof(*component));
+    size_t *stack = calloc(g->count, sizeof(*stack));
+    size_t *next = calloc(g->count, sizeof(*next));
+    size_t visited = 0;
+    size_t open_count = 0;
+
+    for (size_t root = 0; root < g->count; root++) {
+        if (index[root] != 0)
+            continue;
+
+        size_t depth = 0;
+        index[root] = low[root] = ++visited;
+        open[root] = true;
+        component[open_count++] = root;
+        stack[depth++] = root;
+        while (depth > 0) {
+            size_t top = stack[depth - 1];
+            struct call_graph_node *node = g->nodes + top;
+
+            if (next[top] < node->callees_count) {
+                size_t callee = node->callees[next[top]++];
+                if (callee == top) {
+                    recursive[top] = true;
+                } else if (index[callee] == 0) {
+                    index[callee] = low[callee] = ++visited;
+                    open[callee] = true;
+                    component[open_count++] = callee;
+                    stack[depth++] = callee;
+                } else if (open[callee] && index[callee] < low[top]) {
+                    low[top] = index[callee];
+                }
+                continue;
+            }
+
+            depth--;
+            if (depth > 0 && low[top] < low[stack[depth - 1]])
+                low[stack[depth - 1]] = low[top];
+            if (low[top] != index[top])
+                continue;
+
+            size_t first = open_count;
+            do {
+                open[component[--first]] = false;
+            } while (component[first] != top);
+            for (size_t i = first; open_count - first > 1 && i < open_count; i++)
+                recursive[component[i]] = true;
+            open_count = first;
+        }
+    }
+
+    free(next);
+    free(stack);
+    free(component);
+    free(open);
+    free(low);
+    free(index);
+    return recursive;
+}
+
+void call_graph_free(struct call_graph *g)
+{
+    for (size_t i = 0; i < g->count; i++) {
+        free(g->nodes[i].callees);
+        free(g->nodes[i].callers);
+    }
+    free(g->nodes);
+    function_index_free(&g->index);
+    memset(g, 0, sizeof(*g));
+}
@@ -2,21 +2,87 @@
 #include <codegen.h>
 #include <str.h>
 #include <str_builder.h>
+#include <diagnostic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stack/ast_stack.h>
+#include <call_graph.h>
+#include <profile.h>
+#include <trace.h>
+#include <bench.h>
 
 static bool _emit_c(struct str_builder *b, struct ast *a);
 static void _emit_body(struct str_builder *b, struct ast *body);
 static void _emit_fn(struct str_builder *b, struct analyzable_function *fn);
+static void _emit_fn_signature(struct str_builder *b, struct analyzable_function *fn);
+static void _emit_fn_head(struct str_builder *b, struct analyzable_function *fn, const char *name);
 static void _emit_type(struct str_builder *b, struct analyzable_type *type);
 static void _emit_type_cast(struct str_builder *b, struct analyzable_type *type);
 static void _emit_fn_call(struct str_builder *b, struct analyzable_call *call);
+static void _emit_tail_call(struct str_builder *b, struct analyzable_call *call);
 static void _emit_for(struct str_builder *b, struct analyzable_for *loop);
 static void _emit_while(struct str_builder *b, struct analyzable_while *loop);
 static void _emit_if(struct str_builder *b, struct analyzable_if *cond);
-static void _emit_elsif(struct str_builder *b, struct analyzable_elsif *cond);
+static void _emit_elsif(struct str_builder *b, struct analyzable_elsif *cond, uint64_t *evaluated);
+static void _emit_operation(struct str_builder *b, struct ast *root);
+static void _emit_line(struct str_builder *b, struct ast *stmt);
+
+/* bodies up to this many nodes are cheap enough to copy into every caller */
+#define INLINE_MAX_COST 24
+
+/* the function whose body is being emitted, what a tail call jumps back into */
+static struct analyzable_function *emitting;
+
+bool codegen_instrument = false;
+struct profile *codegen_profile = NULL;
+bool codegen_trace = false;
+bool codegen_bench = false;
+const char *codegen_source_name = NULL;
+
+/* the names of the traced functions, their position is the id they record with */
+static struct str_builder *trace_names;
+static size_t trace_count;
+/* a line of tz_benches per bench function */
+static struct str_builder *bench_table;
+
+/* the next counter of the function being emitted, and what the profile counted for it */
+static size_t profile_site;
+static const struct profile_counts *profile_counts;
+/* a line per instrumented function for the code that writes the profile out */
+static struct str_builder *profile_dumps;
+
+/* libc is reached under names of its own, the program may declare these differently or not at all */
+static const char profile_writer[] =
+    "#define tz_profile_str2(x) #x\n"
+    "#define tz_profile_str(x) tz_profile_str2(x)\n"
+    "#define tz_profile_symbol(name) __asm__(tz_profile_str(__USER_LABEL_PREFIX__) name)\n"
+    "extern void *tz_profile_fopen(const char *, const char *) tz_profile_symbol(\"fopen\");\n"
+    "extern int tz_profile_fprintf(void *, const char *, ...) tz_profile_symbol(\"fprintf\");\n"
+    "extern int tz_profile_fclose(void *) tz_profile_symbol(\"fclose\");\n"
+    "extern char *tz_profile_getenv(const char *) tz_profile_symbol(\"getenv\");\n"
+    "\n"
+    "static void tz_profile_dump(void *f, const char *name, const u64 *counts, unsigned long count)\n"
+    "{\n"
+    "tz_profile_fprintf(f, \"%s %lu\", name, count);\n"
+    "for (unsigned long i = 0; i < count; i++)\n"
+    "tz_profile_fprintf(f, \" %llu\", (unsigned long long)counts[i]);\n"
+    "tz_profile_fprintf(f, \"\\n\");\n"
+    "}\n"
+    "\n"
+    "__attribute__((destructor)) static void tz_profile_write(void)\n"
+    "{\n"
+    "const char *path = tz_profile_getenv(\"TANZANITE_PROFILE\");\n"
+    "void *f = tz_profile_fopen(path != 0 && *path != 0 ? path : \"" PROFILE_DEFAULT_PATH "\", \"w\");\n"
+    "if (f == 0)\n"
+    "return;\n"
+    "tz_profile_fprintf(f, \"" PROFILE_HEADER "\\n\");\n";
+
+static void _emit_prototypes(struct str_builder *b, struct ast *program);
+static void _emit_profile_ordered(struct str_builder *b, struct ast *program);
+static unsigned _profile_attributes(struct analyzable_function *fn);
+static void _emit_prototype(struct str_builder *b, struct analyzable_function *fn, bool internal);
 
 static void _emit_fn_decl(struct str_builder *b, struct ast *decl);
 static void _emit_fn_def(struct str_builder *b, struct ast *def);
@@ -24,18 +90,130 @@ static void _emit_fn_def(struct str_builder *b, struct ast *def);
 struct str emit_c(struct ast *ast)
 {
     struct str_builder b = {0};
+    /* a failed emit may have stopped inside a function, with the names of its frame still set */
+    emitting = NULL;
+    trace_names = NULL;
+    trace_count = 0;
+    bench_table = NULL;
 
     if (ast->type != PROGRAM) {
-        fprintf(stderr, "Expected node type PROGRAM!\n");
-        abort();
+        fatal("Expected node type PROGRAM!");
     }
 
-    _emit_body(&b, ast->u.program);
+    struct str_builder dumps = {0};
+    profile_dumps = &dumps;
+    struct str_builder names = {0};
+    if (codegen_trace) {
+        trace_names = &names;
+        trace_count = 0;
+        str_builder_append_cstr(&b, trace_runtime);
+        str_builder_append_char(&b, '\n');
+    }
+    struct str_builder benches = {0};
+    if (codegen_bench) {
+        bench_table = &benches;
+        str_builder_append_cstr(&b, bench_runtime);
+        str_builder_append_char(&b, '\n');
+    }
+
+    _emit_prototypes(&b, ast);
+    if (codegen_profile != NULL)
+        _emit_profile_ordered(&b, ast);
+    else
+        _emit_body(&b, ast->u.program);
+
+    /* what follows the program was never written in it */
+    if (codegen_source_name != NULL && (codegen_instrument || codegen_trace || codegen_bench))
+        str_builder_append_cstr(&b, "#line 1 \"" CODEGEN_RUNTIME_NAME "\"\n");
+
+    if (codegen_instrument) {
+        str_builder_append_cstr(&b, profile_writer);
+        if (dumps.buffer.str != NULL)
+            str_builder_append_str(&b, dumps.buffer);
+        str_builder_append_cstr(&b, "tz_profile_fclose(f);\n}\n");
+    }
+    str_builder_deinit(&dumps);
+    profile_dumps = NULL;
+
+    if (codegen_trace) {
+        str_builder_append_cstr(&b, "static const char *const tz_trace_names[] = {\n");
+        if (names.buffer.str != NULL)
+            str_builder_append_str(&b, names.buffer);
+        str_builder_append_cstr(&b, "0\n};\n\n");
+        str_builder_append_cstr(&b, trace_writer);
+    }
+    str_builder_deinit(&names);
+    trace_names = NULL;
+
+    if (codegen_bench) {
+        str_builder_append_cstr(&b, "static const struct tz_bench tz_benches[] = {\n");
+        if (benches.buffer.str != NULL)
+            str_builder_append_str(&b, benches.buffer);
+        str_builder_append_cstr(&b, "{0, 0}\n};\n\n");
+        str_builder_append_cstr(&b, bench_main);
+    }
+    str_builder_deinit(&benches);
+    bench_table = NULL;
 
     struct str s = str_builder_str(&b);
     return s;
 }
 
+struct str emit_c_statement(struct ast *stmt)
+{
+    struct str_builder b = {0};
+
+    _emit_line(&b, stmt);
+    if (_emit_c(&b, stmt))
+        str_builder_append_cstr(&b, ";\n");
+
+    return str_builder_str(&b);
+}
+
+struct str emit_c_declaration(struct ast *stmt)
+{
+    struct str_builder b = {0};
+
+    switch (stmt->type) {
+    case ANALYZE_FN:
+        _emit_fn_signature(&b, &stmt->u.a_fn);
+        str_builder_append_cstr(&b, ";\n");
+        break;
+    case ANALYZE_IMPORT:
+        for (size_t i = 0; i < stmt->u.a_import.functions_count; i++) {
+            _emit_fn_signature(&b, stmt->u.a_import.functions + i);
+            str_builder_append_cstr(&b, ";\n");
+        }
+        break;
+    case ANALYZE_VAR:
+        str_builder_append_cstr(&b, "extern ");
+        _emit_type(&b, &stmt->u.a_var.type);
+        str_builder_printf(&b, " %s;\n", stmt->u.a_var.identifier.str);
+        break;
+    default:
+        break;
+    }
+
+    return str_builder_str(&b);
+}
+
+struct str emit_c_prototype(struct analyzable_function *fn, bool internal)
+{
+    struct str_builder b = {0};
+
+    _emit_prototype(&b, fn, internal);
+
+    return str_builder_str(&b);
+}
+
+struct str emit_c_expression(struct ast *expr)
+{
+    struct str_builder b = {0};
+
+    _emit_c(&b, expr);
+
+    return str_builder_str(&b);
+}
 
 static bool _emit_c(struct str_builder *b, struct ast *a)
 {
@@ -59,14 +237,16 @@ static bool _emit_c(struct str_builder *b, struct ast *a)
         str_builder_printf(b, "\"%s\"", a->u.string.str);
         break;
     case BRACKETS:
-        str_builder_append_char(b, '(');
-        _emit_c(b, a->u.bracket);
-        str_builder_append_char(b, ')');
+        _emit_operation(b, a);
         break;
     case UNARY:
         str_builder_printf(b, "%s", a->u.unary.op);
         _emit_c(b, a->u.unary.value);
         break;
+    case POINTER_DEREF:
+        str_builder_append_char(b, '*');
+        _emit_c(b, a->u.to_deref);
+        break;
     case ANALYZE_VALUE:
         _emit_type_cast(b, &a->u.a_value.result);
         _emit_c(b, a->u.a_value.value);
@@ -85,19 +265,27 @@ static bool _emit_c(struct str_builder *b, struct ast *a)
         return false;
         break;
     case ANALYZE_FN_CALL:
+        if (a->u.a_fn_call.tail) {
+            _emit_tail_call(b, &a->u.a_fn_call);
+            return false;
+        }
         _emit_type_cast(b, &a->u.a_fn_call.result_type);
         _emit_fn_call(b, &a->u.a_fn_call);
         break;
     case ANALYZE_OPERATION:
-        _emit_type_cast(b, &a->u.a_operation.result_type);
-        _emit_c(b, a->u.a_operation.left);
-        str_builder_append_cstr(b, a->u.a_operation.operation);
-        _emit_c(b, a->u.a_operation.right);
+        _emit_operation(b, a);
         break;
     case ANALYZE_TYPE_CAST:
         _emit_type_cast(b, &a->u.a_cast.target);
         _emit_c(b, a->u.a_cast.value);
         break;
+    case ANALYZE_EMITTED:
+        str_builder_append_str(b, a->u.a_emitted.code);
+        break;
+    case ANALYZE_IMPORT:
+        for (size_t i = 0; i < a->u.a_import.functions_count; i++)
+            _emit_fn(b, a->u.a_import.functions + i);
+        return false;
     case ANALYZE_FOR:
         _emit_for(b, &a->u.a_for);
         return false;
@@ -140,21 +328,385 @@ static bool _emit_c(struct str_builder *b, struct ast *a)
     case FOR:
     case WHILE:
     case FIELD_ACCESS:
-    case POINTER_DEREF:
     case TYPE_CAST:
     case VARIADIC:
     case RANGE:
-        fprintf(stderr, "Unhandled node type %d!\n", a->type);
-        abort();
+    case LAZY_BODY:
+    case IMPORT:
+    case BENCH:
+        fatal("Unhandled node type %d!", a->type);
     }
 
     return true;
 }
 
+/* operations nest as deep as the input does, walk them with a heap stack */
+static void _emit_operation(struct str_builder *b, struct ast *root)
+{
+    struct ast_stack stack = {0};
+    uint32_t it = ast_stack_push(&stack);
+    stack_value(&stack, it) = (struct ast_frame){ root, 0 };
+
+    while (stack.len > 0) {
+        struct ast_frame *frame = &stack_value(&stack, stack_top(&stack));
+        struct ast *node = frame->node;
+        struct ast *child = NULL;
+
+        switch (frame->state++) {
+        case 0:
+            if (node->type == BRACKETS) {
+                str_builder_append_char(b, '(');
+                child = node->u.bracket;
+            } else {
+                _emit_type_cast(b, &node->u.a_operation.result_type);
+                str_builder_append_char(b, '(');
+                child = node->u.a_operation.left;
+            }
+            break;
+        case 1:
+            if (node->type == ANALYZE_OPERATION) {
+                str_builder_append_cstr(b, node->u.a_operation.operation);
+                child = node->u.a_operation.right;
+                break;
+            }
+            /* fallthrough */
+        default:
+            str_builder_append_char(b, ')');
+            ast_stack_pop(&stack);
+            continue;
+        }
+
+        if (child->type == ANALYZE_OPERATION || child->type == BRACKETS) {
+            it = ast_stack_push(&stack);
+            stack_value(&stack, it) = (struct ast_frame){ child, 0 };
+        } else {
+            _emit_c(b, child);
+        }
+    }
+
+    ast_stack_free(&stack);
+}
+
+/*
+ * Every function is declared up front, callees first. Only the prototypes of
+ * internal functions say static, their definitions take the linkage from it.
+ */
+static void _emit_prototypes(struct str_builder *b, struct ast *program)
+{
+    struct call_graph g;
+    call_graph_build(&g, program);
+    size_t *order = call_graph_order(&g);
+
+    for (size_t i = 0; i < g.count; i++) {
+        struct analyzable_function *fn = &g.nodes[order[i]].fn->u.a_fn;
+        _emit_prototype(b, fn, !fn->exported);
+    }
+    if (g.count > 0)
+        str_builder_append_char(b, '\n');
+
+    free(order);
+    call_graph_free(&g);
+}
+
+struct placement {
+    /* ran, missing from the profile, never called */
+    int group;
+    uint64_t calls;
+    size_t index;
+};
+
+static int _compare_placements(const void *a, const void *b)
+{
+    const struct placement *l = a, *r = b;
+    if (l->group != r->group)
+        return l->group < r->group ? -1 : 1;
+    if (l->calls != r->calls)
+        return l->calls > r->calls ? -1 : 1;
+    return l->index < r->index ? -1 : l->index > r->index;
+}
+
+/*
+ * Everything but the function definitions stays where it was, the prototypes
+ * let the definitions follow in any order. The most called come first, the
+ * ones that never ran last, so what runs together sits together.
+ */
+static void _emit_profile_ordered(struct str_builder *b, struct ast *program)
+{
+    struct call_graph g;
+    call_graph_build(&g, program);
+
+    for (struct ast *iter = program->u.program; iter != NULL; iter = iter->u.statement.next) {
+        struct ast *stmt = iter->u.statement.current;
+        if (stmt->type == ANALYZE_FN) {
+            size_t index = call_graph_find(&g, stmt->u.a_fn.name.str);
+            if (index < g.count && g.nodes[index].fn == stmt)
+                continue;
+        }
+        _emit_line(b, stmt);
+        if (_emit_c(b, stmt))
+            str_builder_append_cstr(b, ";\n");
+    }
+
+    struct placement *order = calloc(g.count, sizeof(*order));
+    for (size_t i = 0; i < g.count; i++) {
+        const struct profile_counts *counts = profile_find(codegen_profile, g.nodes[i].fn->u.a_fn.name.str);
+        order[i].index = i;
+        if (counts == NULL || counts->count == 0)
+            order[i].group = 1;
+        else if ((order[i].calls = counts->counts[0]) == 0)
+            order[i].group = 2;
+    }
+    qsort(order, g.count, sizeof(*order), _compare_placements);
+
+    for (size_t i = 0; i < g.count; i++) {
+        _emit_line(b, g.nodes[order[i].index].fn);
+        _emit_fn(b, &g.nodes[order[i].index].fn->u.a_fn);
+    }
+
+    free(order);
+    call_graph_free(&g);
+}
+
+/* hot when it took at least 1% of the calls of the profiled run, cold when it never ran, unless annotated */
+static unsigned _profile_attributes(struct analyzable_function *fn)
+{
+    if (codegen_profile == NULL || fn->declaration || (fn->attributes & (FN_HOT | FN_COLD)))
+        return 0;
+
+    const struct profile_counts *counts = profile_find(codegen_profile, fn->name.str);
+    if (counts == NULL || counts->count == 0)
+        return 0;
+    if (counts->counts[0] == 0)
+        return FN_COLD;
+    return counts->counts[0] * 100 >= codegen_profile->calls ? FN_HOT : 0;
+}
+
+static void _find_call(struct ast *node, void *data)
+{
+    if (node->type == ANALYZE_FN_CALL)
+        *(bool *)data = true;
+}
+
+/* small functions that call nothing else are worth inlining, unless they were asked not to be */
+static bool _inline_candidate(struct analyzable_function *fn)
+{
+    unsigned requested = fn->attributes | _profile_attributes(fn);
+    if (requested & (FN_INLINE | FN_NOINLINE | FN_COLD))
+        return requested & FN_INLINE;
+    if (fn->body == NULL || fn->body->type == LAZY_BODY || fn->cost > INLINE_MAX_COST)
+        return false;
+
+    bool calls = false;
+    walk_nodes(fn->body, _find_call, &calls);
+    return !calls;
+}
+
+/* only internal functions are declared inline, an inline external one would lose its definition */
+static void _emit_prototype(struct str_builder *b, struct analyzable_function *fn, bool internal)
+{
+    if (internal)
+        str_builder_append_cstr(b, _inline_candidate(fn) ? "static inline " : "static ");
+    _emit_fn_signature(b, fn);
+    str_builder_append_cstr(b, ";\n");
+}
+
+static void _find_tail_call(struct ast *node, void *data)
+{
+    if (node->type == ANALYZE_FN_CALL && node->u.a_fn_call.tail)
+        *(bool *)data = true;
+}
+
+/* places the next counter, the profile knows it by its position in the function */
+static size_t _emit_counter(struct str_builder *b)
+{
+    if (codegen_instrument)
+        str_builder_printf(b, "tz_prof_%s[%zu]++;\n", emitting->name.str, profile_site);
+    return profile_site++;
+}
+
+static uint64_t _counted(size_t site)
+{
+    return profile_counts != NULL && site < profile_counts->count ? profile_counts->counts[site] : 0;
+}
+
+/* the value a condition had at least 9 times out of 10, -1 when it had none that often */
+static int _expected(uint64_t taken, uint64_t evaluated, bool inverted)
+{
+    int expected = -1;
+    if (evaluated > 0 && taken * 10 >= evaluated * 9)
+        expected = 1;
+    else if (evaluated > 0 && taken * 10 <= evaluated)
+        expected = 0;
+    return expected >= 0 && inverted ? !expected : expected;
+}
+
+static void _emit_condition(struct str_builder *b, struct ast *expr, int expected)
+{
+    if (expected < 0) {
+        _emit_c(b, expr);
+        return;
+    }
+
+    str_builder_append_cstr(b, "__builtin_expect(!!(");
+    _emit_c(b, expr);
+    str_builder_printf(b, "), %d)", expected);
+}
+
+/* the statements of a function, counters and hints included */
+static struct str _emit_fn_body(struct analyzable_function *fn)
+{
+    struct str_builder b = {0};
+    bool tail = false;
+    walk_nodes(fn->body, _find_tail_call, &tail);
+
+    emitting = fn;
+    profile_counts = codegen_profile != NULL ? profile_find(codegen_profile, fn->name.str) : NULL;
+    for (;;) {
+        profile_site = 0;
+        /* calls, a tail call goes round without coming in again */
+        _emit_counter(&b);
+        if (tail)
+            str_builder_append_cstr(&b, "_tail:;\n");
+        _emit_body(&b, fn->body);
+
+        /* counters that don't line up were counted for another version of the source */
+        if (profile_counts == NULL || profile_counts->count == profile_site)
+            break;
+        str_builder_deinit(&b);
+        profile_counts = NULL;
+    }
+    emitting = NULL;
+
+    return str_builder_str(&b);
+}
+
+/*
+ * The body moves to a function of its own and the function itself only
+ * records when a call starts and ends around it. The value the body leaves
+ * is passed on as it is, and a body that loops on its tail calls is one call.
+ */
+static void _emit_traced(struct str_builder *b, struct analyzable_function *fn, struct str body)
+{
+    struct str_builder inner = {0};
+    str_builder_printf(&inner, "tz_traced_%s", fn->name.str);
+    struct str name = str_builder_str(&inner);
+    bool returns = fn->return_type.pointer_depth > 0 || strcmp(fn->return_type.identifier.str, "void") != 0;
+    size_t id = trace_count++;
+    str_builder_printf(trace_names, "\"%s\",\n", fn->name.str);
+
+    /* the wrapper comes first, so #line directives put it where the function starts */
+    str_builder_append_cstr(b, "static ");
+    _emit_fn_head(b, fn, name.str);
+    str_builder_append_cstr(b, ";\n\n");
+
+    _emit_fn_signature(b, fn);
+    str_builder_append_cstr(b, "\n{\n");
+    str_builder_printf(b, "if (__builtin_expect(tz_trace_enabled, 0))\ntz_trace_record(%zu, 0);\n", id);
+    if (returns) {
+        _emit_type(b, &fn->return_type);
+        str_builder_append_cstr(b, " tz_result = ");
+    }
+    str_builder_printf(b, "%s(", name.str);
+    for (size_t i = 0; i < fn->args_count; i++)
+        str_builder_printf(b, i + 1 < fn->args_count ? "%s, " : "%s", fn->args[i].identifier.str);
+    str_builder_append_cstr(b, ");\n");
+    str_builder_printf(b, "if (__builtin_expect(tz_trace_enabled, 0))\ntz_trace_record(%zu, 1);\n", id);
+    if (returns)
+        str_builder_append_cstr(b, "return tz_result;\n");
+    str_builder_append_cstr(b, "}\n\n");
+
+    str_builder_append_cstr(b, "static ");
+    _emit_fn_head(b, fn, name.str);
+    str_builder_append_cstr(b, "\n{\n");
+    str_builder_append_str(b, body);
+    str_builder_append_cstr(b, "}\n\n");
+
+    str_free(&name);
+}
+
 static void _emit_fn(struct str_builder *b, struct analyzable_function *fn)
+{
+    /* a body that is still unparsed was never reached from main */
+    if (fn->declaration || fn->body->type == LAZY_BODY) {
+        _emit_fn_signature(b, fn);
+        str_builder_append_cstr(b, ";\n\n");
+        return;
+    }
+
+    struct str body = _emit_fn_body(fn);
+    if (bench_table != NULL && fn->bench.str != NULL)
+        str_builder_printf(bench_table, "{\"%s\", %s},\n", fn->bench.str, fn->name.str);
+    if (codegen_instrument) {
+        str_builder_printf(b, "static u64 tz_prof_%s[%zu];\n", fn->name.str, profile_site);
+        if (profile_dumps != NULL)
+            str_builder_printf(profile_dumps, "tz_profile_dump(f, \"%s\", tz_prof_%s, %zu);\n",
+                fn->name.str, fn->name.str, profile_site);
+    }
+
+    if (trace_names != NULL && !fn->variadic) {
+        _emit_traced(b, fn, body);
+        str_free(&body);
+        return;
+    }
+
+    _emit_fn_signature(b, fn);
+    str_builder_append_cstr(b, "\n{\n");
+    str_builder_append_str(b, body);
+    str_builder_append_cstr(b, "}\n\n");
+    str_free(&body);
+}
+
+/* main is run for what it does, and a void function that does nothing is worth no attribute */
+static const char *_effect_attribute(struct analyzable_function *fn)
+{
+    /* counters and trace events are side effects the C compiler must not drop */
+    if (codegen_instrument || codegen_trace || strcmp(fn->name.str, "main") == 0
+            || (fn->return_type.pointer_depth == 0 && strcmp(fn->return_type.identifier.str, "void") == 0))
+        return NULL;
+
+    switch (fn->effect) {
+    case FN_CONST:
+        return "const";
+    case FN_PURE:
+        return "pure";
+    case FN_IMPURE:
+        break;
+    }
+    return NULL;
+}
+
+static void _emit_fn_signature(struct str_builder *b, struct analyzable_function *fn)
+{
+    static const struct { unsigned attribute; const char *name; } attributes[] = {
+        { FN_INLINE, "always_inline" },
+        { FN_NOINLINE, "noinline" },
+        { FN_HOT, "hot" },
+        { FN_COLD, "cold" },
+    };
+
+    unsigned requested = fn->attributes | _profile_attributes(fn);
+    const char *separator = "__attribute__((";
+    for (size_t i = 0; i < sizeof(attributes) / sizeof(*attributes); i++) {
+        if (requested & attributes[i].attribute) {
+            str_builder_printf(b, "%s%s", separator, attributes[i].name);
+            separator = ", ";
+        }
+    }
+    const char *effect = _effect_attribute(fn);
+    if (effect != NULL) {
+        str_builder_printf(b, "%s%s", separator, effect);
+        separator = ", ";
+    }
+    if (*separator == ',')
+        str_builder_append_cstr(b, ")) ");
+
+    _emit_fn_head(b, fn, fn->name.str);
+}
+
+static void _emit_fn_head(struct str_builder *b, struct analyzable_function *fn, const char *name)
 {
     _emit_type(b, &fn->return_type);
-    str_builder_printf(b, " %s(",  fn->name.str);
+    str_builder_printf(b, " %s(",  name);
     for (size_t i = 0; i < fn->args_count; i++) {
         struct analyzable_fn_arg *arg = fn->args + i;
         _emit_type(b, &arg->type);
@@ -167,14 +719,6 @@ static void _emit_fn(struct str_builder *b, struct analyzable_function *fn)
         str_builder_append_cstr(b, "...");
 
     str_builder_append_char(b, ')');
-
-    if (fn->declaration) {
-        str_builder_append_cstr(b, ";\n\n");
-        return;
-    }
-    str_builder_append_cstr(b, "\n{\n");
-    _emit_body(b, fn->body);
-    str_builder_append_cstr(b, "}\n\n");
 }
 
 static void _emit_type(struct str_builder *b, struct analyzable_type *type)
@@ -205,68 +749,95 @@ static void _emit_fn_call(struct str_builder *b, struct analyzable_call *call)
     str_builder_append_char(b, ')');
 }
 
+/* every argument is evaluated before any is replaced, they can read each other */
+static void _emit_tail_call(struct str_builder *b, struct analyzable_call *call)
+{
+    str_builder_append_cstr(b, "{\n");
+    for (size_t i = 0; i < call->args_count; i++) {
+        _emit_type(b, &emitting->args[i].type);
+        str_builder_printf(b, " _tail%zu = ", i);
+        _emit_c(b, call->args[i].value);
+        str_builder_append_cstr(b, ";\n");
+    }
+    for (size_t i = 0; i < call->args_count; i++)
+        str_builder_printf(b, "%s = _tail%zu;\n", emitting->args[i].identifier.str, i);
+    str_builder_append_cstr(b, "goto _tail;\n}\n");
+}
+
+/* loops count how often they are entered and how many rounds they make */
 static void _emit_for(struct str_builder *b, struct analyzable_for *loop)
 {
     if (loop->payload_count == 1 && loop->expr->type == RANGE) {
         struct analyzable_type t = loop->payloads[0].type;
+        _emit_counter(b);
         str_builder_append_cstr(b, "for (");
         _emit_type(b, &t);
         str_builder_printf(b, " %s = %ld;", loop->payloads[0].identifier.str, loop->expr->u.range.start);
         str_builder_printf(b, " %s <= %ld;", loop->payloads[0].identifier.str, loop->expr->u.range.end);
         str_builder_printf(b, " %s++) {\n", loop->payloads[0].identifier.str);
+        _emit_counter(b);
         _emit_body(b, loop->body);
         str_builder_append_cstr(b, "}\n");
     } else {
-        fprintf(stderr, "XXX: very limited, only to range with payload!\n");
-        abort();
+        fatal("XXX: very limited, only to range with payload!");
     }
 }
 
 static void _emit_while(struct str_builder *b, struct analyzable_while *loop)
 {
+    uint64_t entered = _counted(_emit_counter(b));
+    uint64_t rounds = _counted(profile_site);
+
     if (loop->infinite) {
         str_builder_append_cstr(b, "while (true) {\n");
     } else {
-        if (loop->until)
-            str_builder_append_cstr(b, "until (");
-        else
-            str_builder_append_cstr(b, "while (");
-        _emit_c(b, loop->expr);
-        str_builder_append_cstr(b, ") {\n");
+        /* C has no until, it loops while the condition doesn't hold */
+        str_builder_append_cstr(b, loop->until ? "while (!(" : "while (");
+        _emit_condition(b, loop->expr, _expected(rounds, entered + rounds, loop->until));
+        str_builder_append_cstr(b, loop->until ? ")) {\n" : ") {\n");
     }
 
+    _emit_counter(b);
     _emit_body(b, loop->body);
     str_builder_append_cstr(b, "}\n");
 }
 
+/* branches count how often they are reached and taken, an elsif is tested when none before it was taken */
 static void _emit_if(struct str_builder *b, struct analyzable_if *cond)
 {
-    if (cond->unless)
-        str_builder_append_cstr(b, "unless (");
-    else
-        str_builder_append_cstr(b, "if (");
-
-    _emit_c(b, cond->expression);
-    str_builder_append_cstr(b, ") {\n");
+    uint64_t evaluated = _counted(_emit_counter(b));
+    uint64_t taken = _counted(profile_site);
+
+    /* nor unless */
+    str_builder_append_cstr(b, cond->unless ? "if (!(" : "if (");
+    _emit_condition(b, cond->expression, _expected(taken, evaluated, cond->unless));
+    str_builder_append_cstr(b, cond->unless ? ")) {\n" : ") {\n");
+    _emit_counter(b);
     _emit_body(b, cond->body);
     str_builder_append_cstr(b, "} ");
 
+    evaluated -= taken < evaluated ? taken : evaluated;
     for (size_t i = 0; i < cond->elsifs_count; i++) {
-        _emit_elsif(b, cond->elsifs + i);
+        _emit_elsif(b, cond->elsifs + i, &evaluated);
     }
 
     str_builder_append_cstr(b, "\n");
 }
 
-static void _emit_elsif(struct str_builder *b, struct analyzable_elsif *cond)
+static void _emit_elsif(struct str_builder *b, struct analyzable_elsif *cond, uint64_t *evaluated)
 {
+    uint64_t taken = _counted(profile_site);
+
     str_builder_append_cstr(b, "else if (");
 
-    _emit_c(b, cond->expression);
+    _emit_condition(b, cond->expression, _expected(taken, *evaluated, false));
 
     str_builder_append_cstr(b, ") {\n");
+    _emit_counter(b);
     _emit_body(b, cond->body);
     str_builder_append_cstr(b, "} ");
+
+    *evaluated -= taken < *evaluated ? taken : *evaluated;
 }
 
 
@@ -308,21 +879,92 @@ static void _emit_pointer(struct str_builder *b, struct ast *ptr)
     }
 }
 
+static bool _is_void(struct analyzable_type *type)
+{
+    return type->pointer_depth == 0 && strcmp(type->identifier.str, "void") == 0;
+}
+
+/* a statement whose value is thrown away, the C compiler may drop what computed it */
+static bool _discards_value(struct ast *stmt)
+{
+    switch (stmt->type) {
+    case ANALYZE_VALUE:
+        return !_is_void(&stmt->u.a_value.result);
+    case ANALYZE_TYPE_CAST:
+        return !_is_void(&stmt->u.a_cast.target);
+    case ANALYZE_FN_CALL:
+        return !stmt->u.a_fn_call.tail && !_is_void(&stmt->u.a_fn_call.result_type);
+    case ANALYZE_OPERATION:
+    case ASSIGNMENT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* the variables a block defined before stop, kept while they are still in scope */
+static void _emit_bench_keep_variables(struct str_builder *b, struct ast *body, struct ast *stop)
+{
+    for (struct ast *iter = body; iter != NULL && iter != stop; ) {
+        struct ast *stmt = iter->type == STATEMENT ? iter->u.statement.current : iter;
+        if (stmt->type == ANALYZE_VAR && !stmt->u.a_var.is_declaration)
+            str_builder_printf(b, "tz_bench_keep(%s);\n", stmt->u.a_var.identifier.str);
+        iter = iter->type == STATEMENT ? iter->u.statement.next : NULL;
+    }
+}
+
+/*
+ * Inside a bench every block keeps the values it throws away and, before it
+ * ends or is left early, the variables it defined.
+ */
+static void _emit_statement(struct str_builder *b, struct ast *body, struct ast *iter)
+{
+    struct ast *stmt = iter->type == STATEMENT ? iter->u.statement.current : iter;
+    bool bench = emitting != NULL && emitting->bench.str != NULL;
+
+    _emit_line(b, stmt);
+    if (bench && (stmt->type == NEXT || stmt->type == BREAK))
+        _emit_bench_keep_variables(b, body, iter);
+
+    if (bench && _discards_value(stmt)) {
+        str_builder_append_cstr(b, "tz_bench_keep(");
+        _emit_c(b, stmt);
+        str_builder_append_cstr(b, ");\n");
+    } else if (_emit_c(b, stmt)) {
+        str_builder_append_cstr(b, ";\n");
+    }
+}
+
 static void _emit_body(struct str_builder *b, struct ast *body)
 {
     struct ast *iter = body;
+    struct ast *last = body;
 
-    if (iter != NULL && iter->type != STATEMENT) {
-        bool res = _emit_c(b, body);
-        if (res)
-            str_builder_append_cstr(b, ";\n");
-    }
+    if (iter != NULL && iter->type != STATEMENT)
+        _emit_statement(b, body, body);
 
     while (iter != NULL && iter->type == STATEMENT) {
-        bool res = _emit_c(b, iter->u.statement.current);
-        if (res)
-            str_builder_append_cstr(b, ";\n");
-
+        _emit_statement(b, body, iter);
+        last = iter->u.statement.current;
         iter = iter->u.statement.next;
     }
+
+    bool left = last != NULL && (last->type == NEXT || last->type == BREAK);
+    if (emitting != NULL && emitting->bench.str != NULL && !left)
+        _emit_bench_keep_variables(b, body, NULL);
+}
+
+/* the C compiler, and what reads its debug info, report the statement's own line */
+static void _emit_line(struct str_builder *b, struct ast *stmt)
+{
+    if (codegen_source_name == NULL || stmt->span.line <= 0)
+        return;
+
+    str_builder_printf(b, "#line %d \"", stmt->span.line);
+    for (const char *c = codegen_source_name; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            str_builder_append_char(b, '\\');
+        str_builder_append_char(b, *c);
+    }
+    str_builder_append_cstr(b, "\"\n");
 }
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <str.h>
+#include <str_builder.h>
+#include <output.h>
+#include <deps.h>
+
+static void _add(struct str **list, size_t *count, const char *path)
+{
+    for (size_t i = 0; i < *count; i++) {
+        if (strcmp((*list)[i].str, path) == 0)
+            return;
+    }
+
+    *list = realloc(*list, (*count + 1) * sizeof(**list));
+    (*list)[(*count)++] = str_init(path, strlen(path));
+}
+
+void deps_add_target(struct deps *d, const char *path)
+{
+    _add(&d->targets, &d->targets_count, path);
+}
+
+void deps_add_source(struct deps *d, const char *path)
+{
+    _add(&d->sources, &d->sources_count, path);
+}
+
+/* the characters make would otherwise take for its own */
+static void _append_path(struct str_builder *b, struct str path)
+{
+    for (uint64_t i = 0; i < path.size; i++) {
+        char c = path.str[i];
+        if (c == '$')
+            str_builder_append_char(b, '$');
+        else if (c == ' ' || c == '#')
+            str_builder_append_char(b, '\\');
+        str_builder_append_char(b, c);
+    }
+}
+
+bool deps_write(struct deps *d, const char *path)
+{
+    struct str_builder b = {0};
+
+    for (size_t i = 0; i < d->targets_count; i++) {
+        if (i > 0)
+            str_builder_append_char(&b, ' ');
+        _append_path(&b, d->targets[i]);
+    }
+    str_builder_append_char(&b, ':');
+    for (size_t i = 0; i < d->sources_count; i++) {
+        str_builder_append_cstr(&b, " \\\n  ");
+        _append_path(&b, d->sources[i]);
+    }
+    str_builder_append_char(&b, '\n');
+
+    for (size_t i = 0; i < d->sources_count; i++) {
+        str_builder_append_char(&b, '\n');
+        _append_path(&b, d->sources[i]);
+        str_builder_append_cstr(&b, ":\n");
+    }
+
+    struct str content = str_builder_str(&b);
+    bool written = output_write(path, content);
+    str_free(&content);
+    return written;
+}
+
+void deps_free(struct deps *d)
+{
+    for (size_t i = 0; i < d->targets_count; i++)
+        str_free(d->targets + i);
+    for (size_t i = 0; i < d->sources_count; i++)
+        str_free(d->sources + i);
+    free(d->targets);
+    free(d->sources);
+    memset(d, 0, sizeof(*d));
+}
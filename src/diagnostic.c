@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include <diagnostic.h>
+
+static __thread struct diagnostics *captured = NULL;
+
+void diagnostics_capture(struct diagnostics *d)
+{
+    captured = d;
+}
+
+void diagnostics_free(struct diagnostics *d)
+{
+    for (size_t i = 0; i < d->count; i++)
+        free(d->items[i].message);
+    free(d->items);
+    d->items = NULL;
+    d->count = 0;
+}
+
+void diagnostic_print(FILE *f, const struct tanzanite_diagnostic *d)
+{
+    if (d->line > 0)
+        fprintf(f, "%s at line (%d:%d): ", d->severity == TANZANITE_ERROR ? "Error" : "Warning", d->line, d->column);
+    fprintf(f, "%s\n", d->message);
+}
+
+static void _report(enum tanzanite_severity severity, int line, int column, const char *fmt, va_list args)
+{
+    if (captured == NULL) {
+        if (line > 0)
+            fprintf(stderr, "%s at line (%d:%d): ", severity == TANZANITE_ERROR ? "Error" : "Warning", line, column);
+        vfprintf(stderr, fmt, args);
+        fputc('\n', stderr);
+        return;
+    }
+
+    va_list copy;
+    va_copy(copy, args);
+    int size = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+
+    char *message = malloc(size + 1);
+    vsnprintf(message, size + 1, fmt, args);
+
+    captured->items = realloc(captured->items, (captured->count + 1) * sizeof(*captured->items));
+    captured->items[captured->count++] = (struct tanzanite_diagnostic){ severity, line, column, message };
+}
+
+void report(enum tanzanite_severity severity, int line, int column, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    _report(severity, line, column, fmt, args);
+    va_end(args);
+}
+
+void fatal(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    _report(TANZANITE_ERROR, 0, 0, fmt, args);
+    va_end(args);
+
+    if (captured != NULL && captured->unwind != NULL)
+        longjmp(*captured->unwind, 1);
+    abort();
+}
@@ -0,0 +1,153 @@
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include <str.h>
+#include <str_builder.h>
+#include <driver.h>
+#include <output.h>
+
+/* types the generated C expects to exist */
+static const char prelude[] =
+    "#include <stdint.h>\n"
+    "#include <stddef.h>\n"
+    "#include <stdbool.h>\n"
+    "typedef int8_t i8;\n"
+    "typedef uint8_t u8;\n"
+    "typedef int16_t i16;\n"
+    "typedef uint16_t u16;\n"
+    "typedef int32_t i32;\n"
+    "typedef uint32_t u32;\n"
+    "typedef int64_t i64;\n"
+    "typedef uint64_t u64;\n"
+    "typedef float f32;\n"
+    "typedef double f64;\n"
+    "typedef intptr_t isize;\n"
+    "typedef size_t usize;\n";
+
+static const char *_cc(void)
+{
+    const char *cc = getenv("CC");
+    return cc != NULL && *cc != '\0' ? cc : CONFIGURE_CC;
+}
+
+const char *driver_target(const struct driver *d)
+{
+    return d->output != NULL ? d->output : d->object ? "a.o" : "a.out";
+}
+
+static void _start(struct driver *d)
+{
+    struct str_builder tb = {0};
+    str_builder_printf(&tb, "%s.%ld.tmp", driver_target(d), (long)getpid());
+    d->tmp_path = str_builder_str(&tb);
+
+    struct str optimize = {0};
+    if (d->optimize != NULL) {
+        struct str_builder b = {0};
+        str_builder_printf(&b, "-O%s", d->optimize);
+        optimize = str_builder_str(&b);
+    }
+
+    /* the shell splits $CC like make would, "$@" keeps the rest as they are; warnings about generated C are nothing the user can act on */
+    const char *args[16] = { "sh", "-c", "exec $TANZANITE_DRIVER_CC \"$@\"", "sh", "-w", "-x", "c", "-o", d->tmp_path.str };
+    size_t count = 9;
+    if (d->object)
+        args[count++] = "-c";
+    if (optimize.str != NULL)
+        args[count++] = optimize.str;
+    args[count++] = "-";
+    args[count] = NULL;
+
+    int fds[2];
+    if (pipe(fds) != 0) {
+        fprintf(stderr, "unable to start the C compiler: %s\n", strerror(errno));
+        abort();
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    d->pid = fork();
+    if (d->pid == 0) {
+#ifdef __linux__
+        /* when the compiler aborts, half of a program must not be built */
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+        close(fds[1]);
+        dup2(fds[0], STDIN_FILENO);
+        close(fds[0]);
+        setenv("TANZANITE_DRIVER_CC", _cc(), 1);
+        execvp("sh", (char **)args);
+        fprintf(stderr, "unable to run the C compiler: %s\n", strerror(errno));
+        _exit(127);
+    }
+
+    close(fds[0]);
+    str_free(&optimize);
+    /* a compiler that died early shows up in its exit status instead */
+    signal(SIGPIPE, SIG_IGN);
+    if (d->pid < 0 || (d->in = fdopen(fds[1], "w")) == NULL) {
+        fprintf(stderr, "unable to start the C compiler: %s\n", strerror(errno));
+        abort();
+    }
+
+    fputs(prelude, d->in);
+}
+
+FILE *driver_out(struct driver *d)
+{
+    if (!d->enabled)
+        return stdout;
+
+    if (d->in == NULL)
+        _start(d);
+    return d->in;
+}
+
+int driver_finish(struct driver *d)
+{
+    if (!d->enabled)
+        return 0;
+
+    /* an empty program still gets built */
+    driver_out(d);
+
+    fclose(d->in);
+    d->in = NULL;
+
+    int status = 0;
+    while (waitpid(d->pid, &status, 0) < 0 && errno == EINTR)
+        ;
+
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    if (status == 0 && !output_commit(d->tmp_path.str, driver_target(d))) {
+        fprintf(stderr, "unable to write %s: %s\n", driver_target(d), strerror(errno));
+        status = 1;
+    }
+    if (status != 0)
+        remove(d->tmp_path.str);
+    str_free(&d->tmp_path);
+    return status;
+}
+
+void driver_cancel(struct driver *d)
+{
+    if (d->in == NULL)
+        return;
+
+    kill(d->pid, SIGKILL);
+    fclose(d->in);
+    d->in = NULL;
+    waitpid(d->pid, NULL, 0);
+    remove(d->tmp_path.str);
+    str_free(&d->tmp_path);
+}
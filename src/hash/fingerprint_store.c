@@ -0,0 +1,8 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hash.h>
+#include <hash/fingerprint_store.h>
+
+HASH_IMPL(fingerprint_store, struct fingerprint);
@@ -0,0 +1,8 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hash.h>
+#include <hash/function_index.h>
+
+HASH_IMPL(function_index, size_t);
@@ -0,0 +1,8 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hash.h>
+#include <hash/profile_store.h>
+
+HASH_IMPL(profile_store, struct profile_counts);
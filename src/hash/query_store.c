@@ -0,0 +1,8 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hash.h>
+#include <hash/query_store.h>
+
+HASH_IMPL(query_store, struct query_result);
@@ -0,0 +1,8 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hash.h>
+#include <hash/result_store.h>
+
+HASH_IMPL(result_store, struct server_result);
@@ -0,0 +1,8 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hash.h>
+#include <hash/string_pool.h>
+
+HASH_IMPL(string_pool, uint32_t);
@@ -21,6 +21,8 @@ void var_store_push_frame(struct var_store *store)
 
 void var_store_pop_frame(struct var_store *store)
 {
+    if (store->len > 0)
+        var_store_hash_free(&stack_value(store, stack_top(store)));
     var_store_pop(store);
 }
 
@@ -36,6 +38,7 @@ struct var_store_res var_store_find(struct var_store *store, const char *key)
         uint32_t it = var_store_hash_find(hash, key);
         if (hash_exists(hash, it)) {
             res.found = true;
+            res.frame = hash_iter;
             res.payload = hash_value(hash, it);
             break;
         }
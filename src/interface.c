@@ -0,0 +1,476 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ast.h>
+#include <str.h>
+#include <str_builder.h>
+#include <codegen.h>
+#include <interface.h>
+#include <diagnostic.h>
+#include <output.h>
+#include <cache.h>
+
+#define INTERFACE_MAGIC "TZI"
+/* bump when the layout changes */
+#define INTERFACE_VERSION 1
+/* interfaces are only read on machines with the byte order of the one that wrote them */
+#define INTERFACE_BYTE_ORDER 0x01020304
+#define INTERFACE_NONE UINT32_MAX
+
+#define INTERFACE_VARIADIC (1 << 0)
+#define INTERFACE_IMMUTABLE (1 << 1)
+
+/*
+ * An interface is this header, the types, functions and arguments tables and
+ * a pool of NUL terminated strings. Tables refer to each other by index and
+ * to strings by offset into the pool, so a mapped file is used as it is.
+ */
+struct interface_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t types_count;
+    uint32_t functions_count;
+    uint32_t args_count;
+    uint32_t strings_size;
+};
+
+struct interface_type {
+    uint32_t name;
+    uint32_t size;
+    uint32_t pointer_depth;
+};
+
+struct interface_function {
+    uint32_t name;
+    uint32_t return_type;
+    uint32_t first_arg;
+    uint32_t args_count;
+    uint32_t flags;
+};
+
+struct interface_arg {
+    uint32_t name;
+    uint32_t type;
+    /* C of the default value, INTERFACE_NONE if there is none */
+    uint32_t default_value;
+};
+
+struct interface {
+    const struct interface_header *header;
+    const struct interface_type *types;
+    const struct interface_function *functions;
+    const struct interface_arg *args;
+    const char *strings;
+};
+
+struct interface_builder {
+    struct interface_type *types;
+    uint32_t types_count;
+    struct interface_function *functions;
+    uint32_t functions_count;
+    struct interface_arg *args;
+    uint32_t args_count;
+    struct str_builder strings;
+};
+
+/* a validated interface, kept while its file has the same content */
+struct mapped {
+    struct str path;
+    char key[CACHE_KEY_SIZE];
+    struct interface in;
+};
+
+static const char **paths = NULL;
+static size_t paths_count = 0;
+/* interfaces imported so far, for dependency files */
+static struct str *imported = NULL;
+static size_t imported_count = 0;
+/* one per path, a server imports the same ones for request after request */
+static struct mapped *mapped = NULL;
+static size_t mapped_count = 0;
+
+void interface_add_path(const char *dir)
+{
+    paths = realloc(paths, (paths_count + 1) * sizeof(*paths));
+    paths[paths_count++] = dir;
+}
+
+void interface_reset(void)
+{
+    free(paths);
+    paths = NULL;
+    paths_count = 0;
+
+    for (size_t i = 0; i < imported_count; i++)
+        str_free(imported + i);
+    free(imported);
+    imported = NULL;
+    imported_count = 0;
+}
+
+static uint32_t _add_string(struct interface_builder *ib, struct str s)
+{
+    uint32_t offset = ib->strings.buffer.size;
+
+    str_builder_append_str(&ib->strings, s);
+    str_builder_append_char(&ib->strings, '\0');
+    return offset;
+}
+
+/* a module only uses a handful of types, a linear search is enough */
+static uint32_t _add_type(struct interface_builder *ib, struct analyzable_type *type)
+{
+    for (uint32_t i = 0; i < ib->types_count; i++) {
+        struct interface_type *t = ib->types + i;
+        if (t->pointer_depth == type->pointer_depth
+                && strcmp(ib->strings.buffer.str + t->name, type->identifier.str) == 0)
+            return i;
+    }
+
+    ib->types = realloc(ib->types, (ib->types_count + 1) * sizeof(*ib->types));
+    ib->types[ib->types_count] = (struct interface_type){
+        .name = _add_string(ib, (struct str){ type->identifier.str, strlen(type->identifier.str) }),
+        .size = type->size,
+        .pointer_depth = type->pointer_depth,
+    };
+    return ib->types_count++;
+}
+
+static void _add_function(struct interface_builder *ib, struct analyzable_function *fn)
+{
+    struct interface_function f = {
+        .name = _add_string(ib, fn->name),
+        .return_type = _add_type(ib, &fn->return_type),
+        .first_arg = ib->args_count,
+        .args_count = fn->args_count,
+        .flags = (fn->variadic ? INTERFACE_VARIADIC : 0) | (fn->immutable ? INTERFACE_IMMUTABLE : 0),
+    };
+
+    ib->args = realloc(ib->args, (ib->args_count + fn->args_count) * sizeof(*ib->args));
+    for (size_t i = 0; i < fn->args_count; i++) {
+        struct analyzable_fn_arg *arg = fn->args + i;
+        struct interface_arg a = {
+            .name = _add_string(ib, arg->identifier),
+            .type = _add_type(ib, &arg->type),
+            .default_value = INTERFACE_NONE,
+        };
+
+        if (arg->default_value != NULL) {
+            struct str code = emit_c_expression(arg->default_value);
+            a.default_value = _add_string(ib, code);
+            str_free(&code);
+        }
+        ib->args[ib->args_count++] = a;
+    }
+
+    ib->functions = realloc(ib->functions, (ib->functions_count + 1) * sizeof(*ib->functions));
+    ib->functions[ib->functions_count++] = f;
+}
+
+bool interface_write(struct analyzer_context *ctx, struct ast *program, const char *path)
+{
+    struct interface_builder ib = {0};
+
+    struct ast *iter = program->u.program;
+    while (iter != NULL) {
+        struct ast *stmt = iter->u.statement.current;
+        iter = iter->u.statement.next;
+
+        if (stmt->type != ANALYZE_FN || strcmp(stmt->u.a_fn.name.str, "main") == 0)
+            continue;
+
+        /* a declaration followed by its definition is exported once */
+        uint32_t it = function_store_find(&ctx->functions, stmt->u.a_fn.name.str);
+        struct analyzable_function *fn = &hash_value(&ctx->functions, it);
+        if (!fn->exported || (stmt->u.a_fn.declaration && !fn->declaration))
+            continue;
+
+        _add_function(&ib, fn);
+    }
+
+    struct interface_header header = {
+        .magic = INTERFACE_MAGIC,
+        .version = INTERFACE_VERSION,
+        .byte_order = INTERFACE_BYTE_ORDER,
+        .types_count = ib.types_count,
+        .functions_count = ib.functions_count,
+        .args_count = ib.args_count,
+        .strings_size = ib.strings.buffer.size,
+    };
+
+    struct str_builder b = {0};
+    str_builder_printf(&b, "%s.%ld.tmp", path, (long)getpid());
+    struct str tmp_path = str_builder_str(&b);
+
+    /* written under a temporary name, so importers never map half of one */
+    bool written = false;
+    FILE *f = fopen(tmp_path.str, "wb");
+    if (f != NULL) {
+        fwrite(&header, sizeof(header), 1, f);
+        fwrite(ib.types, sizeof(*ib.types), ib.types_count, f);
+        fwrite(ib.functions, sizeof(*ib.functions), ib.functions_count, f);
+        fwrite(ib.args, sizeof(*ib.args), ib.args_count, f);
+        fwrite(ib.strings.buffer.str, 1, ib.strings.buffer.size, f);
+
+        bool failed = ferror(f);
+        written = fclose(f) == 0 && !failed && output_commit(tmp_path.str, path);
+    }
+
+    if (!written) {
+        fprintf(stderr, "unable to write interface %s: %s\n", path, strerror(errno));
+        remove(tmp_path.str);
+    }
+
+    str_free(&tmp_path);
+    str_builder_deinit(&ib.strings);
+    free(ib.types);
+    free(ib.functions);
+    free(ib.args);
+    return written;
+}
+
+static bool _valid(struct interface *in, size_t size)
+{
+    const struct interface_header *h = in->header;
+
+    if (size < sizeof(*h) || memcmp(h->magic, INTERFACE_MAGIC, sizeof(h->magic)) != 0
+            || h->version != INTERFACE_VERSION || h->byte_order != INTERFACE_BYTE_ORDER)
+        return false;
+
+    uint64_t expected = sizeof(*h)
+        + (uint64_t)h->types_count * sizeof(struct interface_type)
+        + (uint64_t)h->functions_count * sizeof(struct interface_function)
+        + (uint64_t)h->args_count * sizeof(struct interface_arg)
+        + h->strings_size;
+    if (expected != size)
+        return false;
+
+    in->types = (const struct interface_type *)(h + 1);
+    in->functions = (const struct interface_function *)(in->types + h->types_count);
+    in->args = (const struct interface_arg *)(in->functions + h->functions_count);
+    in->strings = (const char *)(in->args + h->args_count);
+
+    /* every string ends inside the pool once its last byte is a NUL */
+    if (h->strings_size > 0 && in->strings[h->strings_size - 1] != '\0')
+        return false;
+
+    for (uint32_t i = 0; i < h->types_count; i++) {
+        if (in->types[i].name >= h->strings_size)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < h->functions_count; i++) {
+        const struct interface_function *fn = in->functions + i;
+        if (fn->name >= h->strings_size || fn->return_type >= h->types_count
+                || fn->first_arg > h->args_count || fn->args_count > h->args_count - fn->first_arg)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < h->args_count; i++) {
+        const struct interface_arg *arg = in->args + i;
+        if (arg->name >= h->strings_size || arg->type >= h->types_count
+                || (arg->default_value != INTERFACE_NONE && arg->default_value >= h->strings_size))
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * Imported names point into the mapping, so it stays mapped until the
+ * compiler exits. A file with the content it had when last imported is
+ * hashed again, but neither mapped nor checked again.
+ */
+static struct interface _map(const char *path)
+{
+    struct interface in = {0};
+    struct stat st;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fatal("unable to open interface %s: %s!", path, strerror(errno));
+    }
+
+    void *data = MAP_FAILED;
+    if ((size_t)st.st_size >= sizeof(*in.header))
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fatal("interface %s is corrupt or from another version!", path);
+    }
+
+    char key[CACHE_KEY_SIZE];
+    cache_key(key, "interface", data, st.st_size);
+    struct mapped *m = NULL;
+    for (size_t i = 0; i < mapped_count && m == NULL; i++) {
+        if (strcmp(mapped[i].path.str, path) == 0)
+            m = mapped + i;
+    }
+    if (m != NULL && strcmp(m->key, key) == 0) {
+        munmap(data, st.st_size);
+        return m->in;
+    }
+
+    in.header = data;
+    if (!_valid(&in, st.st_size)) {
+        munmap(data, st.st_size);
+        fatal("interface %s is corrupt or from another version!", path);
+    }
+
+    /* the old content stays mapped, names from it may still be in use */
+    if (m != NULL) {
+        str_free(&m->path);
+    } else {
+        mapped = realloc(mapped, (mapped_count + 1) * sizeof(*mapped));
+        m = mapped + mapped_count++;
+    }
+    *m = (struct mapped){ str_init(path, strlen(path)), {0}, in };
+    memcpy(m->key, key, sizeof(key));
+    return in;
+}
+
+static struct str _find(const char *module)
+{
+    for (size_t i = 0; i <= paths_count; i++) {
+        struct str_builder b = {0};
+        str_builder_printf(&b, "%s/%s.tzi", i < paths_count ? paths[i] : ".", module);
+
+        struct str path = str_builder_str(&b);
+        if (access(path.str, R_OK) == 0)
+            return path;
+        str_free(&path);
+    }
+
+    fatal("unable to find interface of module %s!", module);
+}
+
+static struct str _string(struct interface *in, uint32_t offset)
+{
+    const char *s = in->strings + offset;
+    return (struct str){ (char *)s, strlen(s) };
+}
+
+static struct analyzable_type _type(struct analyzer_context *ctx, struct interface *in, uint32_t index, const char *module)
+{
+    const struct interface_type *type = in->types + index;
+    const char *name = in->strings + type->name;
+
+    uint32_t it = type_store_find(&ctx->types, name);
+    if (!hash_exists(&ctx->types, it) || hash_value(&ctx->types, it).size != type->size) {
+        fatal("module %s uses type %s, which does not exist here!", module, name);
+    }
+
+    struct analyzable_type t = hash_value(&ctx->types, it);
+    t.pointer_depth = type->pointer_depth;
+    return t;
+}
+
+static bool _same_type(struct analyzable_type *a, struct analyzable_type *b)
+{
+    return a->pointer_depth == b->pointer_depth && strcmp(a->identifier.str, b->identifier.str) == 0;
+}
+
+static bool _same_signature(struct analyzable_function *a, struct analyzable_function *b)
+{
+    if (!_same_type(&a->return_type, &b->return_type) || a->immutable != b->immutable
+            || a->variadic != b->variadic || a->args_count != b->args_count)
+        return false;
+
+    for (size_t i = 0; i < a->args_count; i++) {
+        if (!_same_type(&a->args[i].type, &b->args[i].type))
+            return false;
+    }
+
+    return true;
+}
+
+static void _free_args(struct analyzable_function *fn)
+{
+    for (size_t i = 0; i < fn->args_count; i++)
+        free_node_shell(fn->args[i].default_value);
+    ast_free(fn->args);
+}
+
+struct ast interface_import(struct analyzer_context *ctx, struct ast *import)
+{
+    const char *module = import->u.import.str;
+    struct str path = _find(module);
+    struct interface in = _map(path.str);
+    imported = realloc(imported, (imported_count + 1) * sizeof(*imported));
+    imported[imported_count++] = path;
+
+    struct ast node = {0};
+    node.type = ANALYZE_IMPORT;
+    node.u.a_import.module = import->u.import;
+    node.u.a_import.functions = ast_alloc(in.header->functions_count, sizeof(struct analyzable_function));
+
+    for (uint32_t i = 0; i < in.header->functions_count; i++) {
+        const struct interface_function *f = in.functions + i;
+        struct analyzable_function fn = {0};
+
+        fn.name = _string(&in, f->name);
+        fn.return_type = _type(ctx, &in, f->return_type, module);
+        fn.variadic = f->flags & INTERFACE_VARIADIC;
+        fn.immutable = f->flags & INTERFACE_IMMUTABLE;
+        fn.declaration = true;
+
+        fn.args_count = f->args_count;
+        fn.args = ast_alloc(fn.args_count, sizeof(*fn.args));
+        for (uint32_t j = 0; j < f->args_count; j++) {
+            const struct interface_arg *a = in.args + f->first_arg + j;
+            struct analyzable_fn_arg *arg = fn.args + j;
+
+            arg->identifier = _string(&in, a->name);
+            arg->type = _type(ctx, &in, a->type, module);
+            if (a->default_value != INTERFACE_NONE) {
+                arg->default_value = ast_alloc(1, sizeof(*arg->default_value));
+                arg->default_value->type = ANALYZE_EMITTED;
+                arg->default_value->u.a_emitted.result = arg->type;
+                arg->default_value->u.a_emitted.code = _string(&in, a->default_value);
+            }
+        }
+
+        /* the same C function is often declared by several modules */
+        uint32_t it = function_store_find(&ctx->functions, fn.name.str);
+        if (hash_exists(&ctx->functions, it)) {
+            if (!_same_signature(&hash_value(&ctx->functions, it), &fn)) {
+                fatal("function %s from module %s does not match the one already declared!", fn.name.str, module);
+            }
+            _free_args(&fn);
+            continue;
+        }
+
+        it = function_store_insert(&ctx->functions, fn.name.str);
+        hash_value(&ctx->functions, it) = fn;
+        node.u.a_import.functions[node.u.a_import.functions_count++] = fn;
+    }
+
+    return node;
+}
+
+const struct str *interface_imported(size_t *count)
+{
+    *count = imported_count;
+    return imported;
+}
+
+bool program_imports(struct ast *program)
+{
+    struct ast *iter = program->u.program;
+    while (iter != NULL) {
+        enum node_type type = iter->u.statement.current->type;
+        if (type == IMPORT || type == ANALYZE_IMPORT)
+            return true;
+        iter = iter->u.statement.next;
+    }
+
+    return false;
+}
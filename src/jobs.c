@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+
+#include <str.h>
+#include <str_builder.h>
+#include <jobs.h>
+
+/*
+ * GNU make hands out job tokens as bytes in a pipe, or a named fifo since
+ * 4.4. Every process owns one implicit token, each extra job needs a byte
+ * read from the jobserver, and the same byte goes back once the job ends.
+ */
+struct jobserver {
+    int read_fd;
+    int write_fd;
+    /* tokens taken from the jobserver, returned as they were read */
+    char *tokens;
+    size_t tokens_count;
+};
+
+static void _on_child(int sig)
+{
+    (void)sig;
+}
+
+/* the value of the last jobserver option in MAKEFLAGS, up to the next space */
+static struct str _jobserver_auth(void)
+{
+    static const char *const names[] = { "--jobserver-auth=", "--jobserver-fds=" };
+    const char *flags = getenv("MAKEFLAGS");
+    const char *found = NULL;
+
+    for (size_t i = 0; flags != NULL && i < sizeof(names) / sizeof(*names); i++) {
+        for (const char *p = strstr(flags, names[i]); p != NULL; p = strstr(p + 1, names[i])) {
+            if (found == NULL || p > found)
+                found = p + strlen(names[i]);
+        }
+    }
+
+    if (found == NULL)
+        return (struct str){0};
+
+    size_t size = strcspn(found, " ");
+    return str_init(found, size);
+}
+
+static bool _valid_fd(int fd)
+{
+    return fd >= 0 && fcntl(fd, F_GETFD) != -1;
+}
+
+/*
+ * Reads have to be non-blocking, or a job that ends while we wait for a
+ * token would never give its own back. make's pipe is shared with every
+ * other process of the build, so it's reopened instead of changed.
+ */
+static bool _jobserver_open(struct jobserver *js)
+{
+    struct str auth = _jobserver_auth();
+    int read_fd = -1;
+    int write_fd = -1;
+    struct str_builder b = {0};
+
+    memset(js, 0, sizeof(*js));
+    js->read_fd = js->write_fd = -1;
+    if (auth.str == NULL)
+        return false;
+
+    if (strncmp(auth.str, "fifo:", 5) == 0) {
+        js->read_fd = open(auth.str + 5, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        js->write_fd = open(auth.str + 5, O_WRONLY | O_CLOEXEC);
+    } else if (sscanf(auth.str, "%d,%d", &read_fd, &write_fd) == 2 && _valid_fd(read_fd) && _valid_fd(write_fd)) {
+        str_builder_printf(&b, "/proc/self/fd/%d", read_fd);
+        struct str path = str_builder_str(&b);
+        js->read_fd = open(path.str, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        js->write_fd = write_fd;
+        str_free(&path);
+    }
+
+    str_free(&auth);
+    if (js->read_fd < 0 || js->write_fd < 0) {
+        /* make doesn't pass the pipe to commands it doesn't know are recursive */
+        if (js->read_fd >= 0)
+            close(js->read_fd);
+        js->read_fd = js->write_fd = -1;
+        return false;
+    }
+
+    return true;
+}
+
+static bool _jobserver_acquire(struct jobserver *js)
+{
+    char token = 0;
+    if (js->read_fd < 0 || read(js->read_fd, &token, 1) != 1)
+        return false;
+
+    js->tokens = realloc(js->tokens, js->tokens_count + 1);
+    js->tokens[js->tokens_count++] = token;
+    return true;
+}
+
+static void _jobserver_release(struct jobserver *js)
+{
+    if (js->tokens_count == 0)
+        return;
+
+    char token = js->tokens[--js->tokens_count];
+    while (write(js->write_fd, &token, 1) < 0 && errno == EINTR)
+        ;
+}
+
+static void _jobserver_close(struct jobserver *js)
+{
+    while (js->tokens_count > 0)
+        _jobserver_release(js);
+    free(js->tokens);
+
+    if (js->read_fd >= 0)
+        close(js->read_fd);
+}
+
+static pid_t _start(size_t index, job_run run, void *data, const sigset_t *mask)
+{
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        signal(SIGCHLD, SIG_DFL);
+        sigprocmask(SIG_SETMASK, mask, NULL);
+        exit(run(index, data));
+    }
+
+    if (pid < 0)
+        fprintf(stderr, "unable to start a job: %s\n", strerror(errno));
+    return pid;
+}
+
+/* removes a finished job, returns its status or -1 when none has finished */
+static int _reap(pid_t *running, size_t *running_count)
+{
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, WNOHANG);
+    if (pid <= 0)
+        return -1;
+
+    for (size_t i = 0; i < *running_count; i++) {
+        if (running[i] == pid) {
+            running[i] = running[--*running_count];
+            break;
+        }
+    }
+
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    return 128 + WTERMSIG(status);
+}
+
+int jobs_run(size_t count, unsigned jobs, job_run run, void *data)
+{
+    struct jobserver js;
+    bool shared = _jobserver_open(&js);
+    size_t limit = jobs > 0 ? jobs : shared ? count : 1;
+
+    /* SIGCHLD only gets through while waiting, so none is missed between checks */
+    sigset_t blocked, original, waiting;
+    struct sigaction action = {0}, previous;
+    action.sa_handler = _on_child;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGCHLD, &action, &previous);
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &blocked, &original);
+    waiting = original;
+    sigdelset(&waiting, SIGCHLD);
+
+    pid_t *running = calloc(limit, sizeof(*running));
+    size_t running_count = 0;
+    size_t next = 0;
+    int failed = 0;
+
+    while (running_count > 0 || (next < count && failed == 0)) {
+        int status = 0;
+        while ((status = _reap(running, &running_count)) >= 0) {
+            _jobserver_release(&js);
+            if (status != 0 && failed == 0)
+                failed = status;
+        }
+
+        /* the first job runs on our own token */
+        while (next < count && failed == 0 && running_count < limit
+                && (running_count == 0 || !shared || _jobserver_acquire(&js))) {
+            pid_t pid = _start(next++, run, data, &original);
+            if (pid < 0) {
+                _jobserver_release(&js);
+                failed = 1;
+                break;
+            }
+            running[running_count++] = pid;
+        }
+
+        if (running_count == 0)
+            continue;
+
+        /* a job ending or a token coming free, whichever comes first */
+        fd_set readable;
+        FD_ZERO(&readable);
+        bool wants_token = next < count && failed == 0 && running_count < limit && js.read_fd >= 0;
+        if (wants_token)
+            FD_SET(js.read_fd, &readable);
+        pselect(wants_token ? js.read_fd + 1 : 0, &readable, NULL, NULL, NULL, &waiting);
+    }
+
+    free(running);
+    _jobserver_close(&js);
+    sigprocmask(SIG_SETMASK, &original, NULL);
+    sigaction(SIGCHLD, &previous, NULL);
+    return failed;
+}
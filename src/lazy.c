@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <ast.h>
+#include <str.h>
+#include <parser_state.h>
+#include <parser.h>
+#include <lazy.h>
+#include <diagnostic.h>
+#include <stack/block_stack.h>
+
+bool lazy_bodies = false;
+
+/* blocks closed by end, an if only is one once it can't be an if expression */
+enum block_kind {
+    BLOCK_DO,
+    BLOCK_IF_COND,
+    BLOCK_IF_EMPTY,
+    BLOCK_IF_EXPR,
+    BLOCK_IF,
+};
+
+/* postfix ifs and if expressions follow a value, statement ifs don't */
+static bool _starts_statement(int prev)
+{
+    switch (prev) {
+    case 0:
+    case ';':
+    case THEN_TOK:
+    case DO_TOK:
+    case ELSE_TOK:
+    case END_TOK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void _advance_if(struct block_stack *blocks, int tok, bool opens)
+{
+    uint8_t *kind = &stack_value(blocks, stack_top(blocks));
+
+    switch (*kind) {
+    case BLOCK_IF_COND:
+        if (tok == THEN_TOK)
+            *kind = BLOCK_IF_EMPTY;
+        break;
+    case BLOCK_IF_EMPTY:
+        if (tok == ';' || tok == ELSE_TOK || tok == ELSIF_TOK || opens)
+            *kind = BLOCK_IF;
+        else
+            *kind = BLOCK_IF_EXPR;
+        break;
+    case BLOCK_IF_EXPR:
+        /* `if a then b else c` has no end of its own */
+        if (tok == ELSE_TOK)
+            block_stack_pop(blocks);
+        else if (tok == ';' || tok == ELSIF_TOK || opens)
+            *kind = BLOCK_IF;
+        break;
+    }
+}
+
+/* skips tokens up to the end matching the function, tok is the first one of the body */
+static int _skim_body(struct parser_state *ps, YYSTYPE *lval, int tok)
+{
+    struct block_stack blocks = {0};
+    struct source_range range = { ps->token_offset, 0, lex_line(ps) };
+    int inline_thens = 0;
+    bool elsif = false;
+    int prev = 0;
+
+    ps->signature = SIG_NONE;
+    if (tok == END_TOK)
+        return END_TOK;
+
+    while (tok != END_TOK || blocks.len > 0) {
+        if (tok == 0) {
+            fatal("function body at line %d is missing its end!", range.line);
+        }
+
+        bool opens = tok == DO_TOK || ((tok == IF_TOK || tok == UNLESS_TOK) && _starts_statement(prev));
+        bool waiting = blocks.len > 0 && stack_value(&blocks, stack_top(&blocks)) == BLOCK_IF_COND;
+
+        if (tok == END_TOK) {
+            block_stack_pop(&blocks);
+        } else if (tok == THEN_TOK && !waiting && !elsif) {
+            /* the then of an if expression, its else must not close anything */
+            inline_thens++;
+        } else if (tok == ELSE_TOK && inline_thens > 0) {
+            inline_thens--;
+        } else if (blocks.len > 0) {
+            _advance_if(&blocks, tok, opens);
+        }
+
+        if (tok == ELSIF_TOK || tok == THEN_TOK)
+            elsif = tok == ELSIF_TOK;
+
+        if (opens) {
+            uint32_t it = block_stack_push(&blocks);
+            stack_value(&blocks, it) = tok == DO_TOK ? BLOCK_DO : BLOCK_IF_COND;
+        }
+
+        if (tok == IDENTIFIER_TOK || tok == STRING_TOK)
+            ast_str_free(&lval->str);
+
+        prev = tok;
+        tok = lex_token(lval, ps->scanner);
+    }
+
+    block_stack_free(&blocks);
+
+    range.length = ps->token_offset - range.offset;
+    lval->range = range;
+    ps->queued = END_TOK;
+    return LAZY_BODY_TOK;
+}
+
+static int _filter(YYSTYPE *lval, struct parser_state *ps)
+{
+    if (ps->body_start) {
+        ps->body_start = false;
+        return BODY_START_TOK;
+    }
+
+    if (ps->queued != 0) {
+        int tok = ps->queued;
+        ps->queued = 0;
+        return tok;
+    }
+
+    int tok = lex_token(lval, ps->scanner);
+    if (!lazy_bodies)
+        return tok;
+
+    switch (ps->signature) {
+    case SIG_NONE:
+        if (tok == DEF_TOK || tok == FUN_TOK)
+            ps->signature = SIG_NAME;
+        break;
+    case SIG_NAME:
+        ps->signature = tok == IDENTIFIER_TOK ? SIG_OPEN : SIG_NONE;
+        break;
+    case SIG_OPEN:
+        ps->signature = tok == '(' ? SIG_ARGS : SIG_NONE;
+        ps->paren_depth = 1;
+        break;
+    case SIG_ARGS:
+        if (tok == '(')
+            ps->paren_depth++;
+        else if (tok == ')' && --ps->paren_depth == 0)
+            ps->signature = SIG_AFTER_ARGS;
+        break;
+    case SIG_AFTER_ARGS:
+        if (tok == ':') {
+            ps->signature = SIG_TYPE;
+            break;
+        }
+        return _skim_body(ps, lval, tok);
+    case SIG_TYPE:
+        if (tok == IDENTIFIER_TOK)
+            ps->signature = SIG_BODY;
+        else if (tok != '*')
+            ps->signature = SIG_NONE;
+        break;
+    case SIG_BODY:
+        return _skim_body(ps, lval, tok);
+    }
+
+    return tok;
+}
+
+/* where the token starts and ends, the ones the filter makes up sit at the last token read */
+static void _locate(struct parser_state *ps, int tok, YYLTYPE *lloc)
+{
+    lloc->last_line = lex_line(ps);
+    lloc->last_column = ps->column;
+    /* the end of the input is where reading stopped */
+    lloc->first_line = tok != 0 ? ps->token_line : lloc->last_line;
+    lloc->first_column = tok != 0 ? ps->token_column : lloc->last_column;
+}
+
+int yylex(YYSTYPE *lval, YYLTYPE *lloc, struct parser_state *ps)
+{
+    int tok = _filter(lval, ps);
+    _locate(ps, tok, lloc);
+    return tok;
+}
@@ -1,20 +1,716 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
 #include <ast.h>
 
 #include <analyzer.h>
 #include <analyzer/context.h>
 
 #include <codegen.h>
+#include <str_builder.h>
+#include <stream.h>
+#include <lazy.h>
+#include <cache.h>
+#include <query.h>
+#include <interface.h>
+#include <ast_cache.h>
+#include <server.h>
+#include <driver.h>
+#include <jobs.h>
+#include <shard.h>
+#include <output.h>
+#include <deps.h>
+#include <profile.h>
+#include <source_map.h>
 
-int main()
+static const struct option options[] = {
+    { "stream", no_argument, NULL, 's' },
+    { "lazy",   no_argument, NULL, 'l' },
+    { "parse-jobs", required_argument, NULL, 'p' },
+    { "cache-dir",  required_argument, NULL, 'c' },
+    { "incremental", no_argument, NULL, 'i' },
+    { "interface",   required_argument, NULL, 'm' },
+    { "import-path", required_argument, NULL, 'I' },
+    { "save-ast",    required_argument, NULL, 'a' },
+    { "load-ast",    required_argument, NULL, 'A' },
+    { "server",      required_argument, NULL, 'S' },
+    { "connect",     required_argument, NULL, 'C' },
+    { "output",      required_argument, NULL, 'o' },
+    { "compile",     no_argument,       NULL, 'b' },
+    { "optimize",    optional_argument, NULL, 'O' },
+    { "jobs",        required_argument, NULL, 'j' },
+    { "split",       required_argument, NULL, 'k' },
+    { "split-prefix", required_argument, NULL, 'P' },
+    { "deps",        optional_argument, NULL, 'D' },
+    { "deps-target", required_argument, NULL, 'T' },
+    { "instrument",  no_argument,       NULL, 'G' },
+    { "use-profile", required_argument, NULL, 'U' },
+    { "trace-functions", no_argument,   NULL, 'F' },
+    { "line-directives", no_argument,   NULL, 'L' },
+    { "source-map",  required_argument, NULL, 'M' },
+    { "bench",       no_argument,       NULL, 'B' },
+    { "help",   no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 },
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [options] < input\n", prog);
+    fprintf(stderr, "       %s [options] input...\n", prog);
+    fprintf(stderr, "  every input file gets its own .c, or .o with --compile, next to it\n");
+    fprintf(stderr, "  -s, --stream   analyze and emit one function at a time\n");
+    fprintf(stderr, "  -l, --lazy     only parse bodies of functions reachable from main\n");
+    fprintf(stderr, "  -p, --parse-jobs N\n");
+    fprintf(stderr, "                 parse the input as N chunks on separate threads\n");
+    fprintf(stderr, "  -c, --cache-dir DIR\n");
+    fprintf(stderr, "                 reuse C generated earlier for the same input and options,\n");
+    fprintf(stderr, "                 defaults to $TANZANITE_CACHE_DIR\n");
+    fprintf(stderr, "  -i, --incremental\n");
+    fprintf(stderr, "                 also keep the C of every function in the cache directory and\n");
+    fprintf(stderr, "                 only check bodies whose source or callees changed, implies -l\n");
+    fprintf(stderr, "  -m, --interface FILE\n");
+    fprintf(stderr, "                 also write the signatures of the @[export] functions to FILE,\n");
+    fprintf(stderr, "                 for modules importing this one\n");
+    fprintf(stderr, "  -I, --import-path DIR\n");
+    fprintf(stderr, "                 look for imported interfaces in DIR before the current one\n");
+    fprintf(stderr, "  -a, --save-ast FILE\n");
+    fprintf(stderr, "                 also write the parsed tree to FILE\n");
+    fprintf(stderr, "  -A, --load-ast FILE\n");
+    fprintf(stderr, "                 use the tree in FILE instead of parsing the input\n");
+    fprintf(stderr, "  -S, --server SOCKET\n");
+    fprintf(stderr, "                 stay running and compile the requests sent to SOCKET\n");
+    fprintf(stderr, "  -C, --connect SOCKET\n");
+    fprintf(stderr, "                 have the server at SOCKET compile the input with the other options\n");
+    fprintf(stderr, "  -o, --output FILE\n");
+    fprintf(stderr, "                 build FILE with the C compiler instead of printing the C\n");
+    fprintf(stderr, "      --compile  build an object instead of linking, a.o unless -o is given\n");
+    fprintf(stderr, "  -O[LEVEL], --optimize[=LEVEL]\n");
+    fprintf(stderr, "                 passed on to the C compiler\n");
+    fprintf(stderr, "  -j, --jobs N   build up to N input files at once, also limited by make's\n");
+    fprintf(stderr, "                 jobserver when there is one\n");
+    fprintf(stderr, "      --split K  write the C as K files, PREFIX-0.c to PREFIX-<K-1>.c, and the\n");
+    fprintf(stderr, "                 declarations they share as PREFIX.h\n");
+    fprintf(stderr, "      --split-prefix PREFIX\n");
+    fprintf(stderr, "                 where --split writes, the input file without its extension\n");
+    fprintf(stderr, "                 by default\n");
+    fprintf(stderr, "      --deps[=FILE]\n");
+    fprintf(stderr, "                 also write a make rule with the files read to FILE, next to\n");
+    fprintf(stderr, "                 the output with a .d extension by default\n");
+    fprintf(stderr, "      --deps-target TARGET\n");
+    fprintf(stderr, "                 also name TARGET in the rule, needed when the C goes to stdout\n");
+    fprintf(stderr, "      --instrument\n");
+    fprintf(stderr, "                 count calls, branches and loop rounds, the program writes them\n");
+    fprintf(stderr, "                 to $TANZANITE_PROFILE, or " PROFILE_DEFAULT_PATH ", when it exits\n");
+    fprintf(stderr, "      --use-profile FILE\n");
+    fprintf(stderr, "                 hint branches, mark functions hot or cold and order them by\n");
+    fprintf(stderr, "                 the counts an instrumented program wrote to FILE\n");
+    fprintf(stderr, "      --trace-functions\n");
+    fprintf(stderr, "                 record when every call starts and ends, the program writes\n");
+    fprintf(stderr, "                 them as Chrome trace events to $TANZANITE_TRACE when it exits\n");
+    fprintf(stderr, "                 or gets SIGUSR1, and records nothing when it isn't set\n");
+    fprintf(stderr, "      --line-directives\n");
+    fprintf(stderr, "                 have the C say which line of the input each statement is on,\n");
+    fprintf(stderr, "                 so the C compiler, debuggers and profilers report those\n");
+    fprintf(stderr, "      --source-map FILE\n");
+    fprintf(stderr, "                 also write which line of the input every line of the C came\n");
+    fprintf(stderr, "                 from to FILE as JSON\n");
+    fprintf(stderr, "      --bench    run the bench blocks instead of main, each until it can be timed,\n");
+    fprintf(stderr, "                 and print the median and 99th percentile time of a run and the\n");
+    fprintf(stderr, "                 runs per second, only those whose names contain the program's\n");
+    fprintf(stderr, "                 first argument when it has one; the blocks are left out without it\n");
+    fprintf(stderr, "  -h, --help     show this help\n");
+}
+
+/* argv without the arguments of the --connect option that starts at first */
+static char **_forwarded_args(int argc, char **argv, int first, int next, int *count)
+{
+    char **args = calloc(argc + 1, sizeof(*args));
+
+    *count = 0;
+    for (int i = 0; i < argc; i++) {
+        if (i < first || i >= next)
+            args[(*count)++] = argv[i];
+    }
+
+    return args;
+}
+
+static int compile(int argc, char **argv, struct str *input, bool *cacheable);
+
+/* input files, each built by a job running the options on its own */
+struct build {
+    int argc;
+    char **argv;
+    char **inputs;
+    /* one input with -o, which names the output */
+    bool named;
+    bool object;
+    /* --split without a prefix, which comes from the input */
+    bool split;
+};
+
+/* the input file and the .c written from it by the job running in this process */
+static const char *job_input = NULL;
+static const char *job_output = NULL;
+
+/* path with its extension replaced */
+static struct str _sibling(const char *path, const char *extension)
+{
+    const char *base = strrchr(path, '/');
+    const char *dot = strrchr(base != NULL ? base : path, '.');
+    size_t size = dot != NULL ? (size_t)(dot - path) : strlen(path);
+
+    struct str_builder b = {0};
+    str_builder_append_str(&b, (struct str){ (char *)path, size });
+    str_builder_append_cstr(&b, extension);
+    return str_builder_str(&b);
+}
+
+static int _build(size_t index, void *data)
+{
+    struct build *b = data;
+    const char *path = b->inputs[index];
+    char **args = calloc(b->argc + 5, sizeof(*args));
+    int count = 0;
+    struct str output = {0};
+    struct str tmp_path = {0};
+
+    if (freopen(path, "r", stdin) == NULL) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    for (; count < b->argc; count++)
+        args[count] = b->argv[count];
+
+    if (b->split) {
+        output = _sibling(path, "");
+        args[count++] = "--split-prefix";
+        args[count++] = output.str;
+    } else if (b->object && !b->named) {
+        output = _sibling(path, ".o");
+        args[count++] = "-o";
+        args[count++] = output.str;
+    } else if (!b->named) {
+        /* make must never see half of a .c as up to date */
+        output = _sibling(path, ".c");
+        struct str_builder tb = {0};
+        str_builder_printf(&tb, "%s.%ld.tmp", output.str, (long)getpid());
+        tmp_path = str_builder_str(&tb);
+        if (freopen(tmp_path.str, "w", stdout) == NULL) {
+            fprintf(stderr, "%s: %s\n", tmp_path.str, strerror(errno));
+            return 1;
+        }
+    }
+
+    job_input = path;
+    job_output = tmp_path.str != NULL ? output.str : NULL;
+
+    /* the options are parsed again, as if they came with this input alone */
+    optind = 0;
+    bool cacheable = false;
+    int status = compile(count, args, NULL, &cacheable);
+
+    if (tmp_path.str != NULL) {
+        if (fflush(stdout) != 0 || ferror(stdout))
+            status = status != 0 ? status : 1;
+        if (status != 0 || !output_commit(tmp_path.str, output.str)) {
+            remove(tmp_path.str);
+            status = status != 0 ? status : 1;
+        }
+    }
+
+    str_free(&tmp_path);
+    str_free(&output);
+    free(args);
+    return status;
+}
+
+/* every file the options make compile write */
+static void _deps_targets(struct deps *deps, const struct driver *driver, unsigned split, const char *split_prefix,
+    const char *interface_path, const char *save_ast, const char *source_map_path)
+{
+    if (job_output != NULL)
+        deps_add_target(deps, job_output);
+    if (driver->enabled)
+        deps_add_target(deps, driver_target(driver));
+
+    for (unsigned i = 0; split > 0 && i <= split; i++) {
+        struct str_builder b = {0};
+        if (i == 0)
+            str_builder_printf(&b, "%s.h", split_prefix);
+        else
+            str_builder_printf(&b, "%s-%u.c", split_prefix, i - 1);
+
+        struct str path = str_builder_str(&b);
+        deps_add_target(deps, path.str);
+        str_free(&path);
+    }
+
+    if (interface_path != NULL)
+        deps_add_target(deps, interface_path);
+    if (save_ast != NULL)
+        deps_add_target(deps, save_ast);
+    if (source_map_path != NULL)
+        deps_add_target(deps, source_map_path);
+}
+
+/* the interfaces are only known once the imports were analyzed */
+static bool _write_deps(struct deps *deps, const char *path)
+{
+    size_t count = 0;
+    const struct str *imported = interface_imported(&count);
+    for (size_t i = 0; i < count; i++)
+        deps_add_source(deps, imported[i].str);
+
+    bool written = deps_write(deps, path);
+    deps_free(deps);
+    return written;
+}
+
+/*
+ * What a server compiles in its own process: the input alone, to stdout,
+ * and nothing written besides an interface. The checks compile() makes of
+ * these options can't fail, requests that would are left to a worker.
+ */
+static bool _warm_options(int argc, char **argv, struct server_warm *warm)
+{
+    bool warm_enough = true;
+    int saved_opterr = opterr;
+    int opt;
+
+    opterr = 0;
+    while (warm_enough && (opt = getopt_long(argc, argv, "slp:c:im:I:a:A:S:C:o:O::j:h", options, NULL)) != -1) {
+        switch (opt) {
+        case 'l':
+            warm->options.lazy = true;
+            break;
+        case 'p':
+            warm_enough = strtoul(optarg, NULL, 10) > 0;
+            break;
+        case 'c':
+            /* the server keeps what the cache would */
+            break;
+        case 'm':
+            warm->options.module = true;
+            warm->interface = optarg;
+            break;
+        case 'I':
+            warm->import_paths = realloc(warm->import_paths, (warm->import_paths_count + 1) * sizeof(*warm->import_paths));
+            warm->import_paths[warm->import_paths_count++] = optarg;
+            break;
+        case 'G':
+            warm->options.instrument = true;
+            break;
+        case 'F':
+            warm->options.trace = true;
+            break;
+        case 'B':
+            warm->options.bench = true;
+            break;
+        case 'L':
+            warm->options.source_name = "<stdin>";
+            break;
+        default:
+            warm_enough = false;
+            break;
+        }
+    }
+    opterr = saved_opterr;
+
+    return warm_enough && optind == argc && !(warm->options.bench && warm->interface != NULL);
+}
+
+/* input, when given, is used in place of stdin */
+static int compile(int argc, char **argv, struct str *input, bool *cacheable)
 {
     struct analyzer_context ctx = {0};
+    bool stream = false;
+    bool incremental = false;
+    const char *interface_path = NULL;
+    const char *save_ast = NULL;
+    const char *load_ast = NULL;
+    unsigned jobs = 1;
+    const char *cache_dir = getenv("TANZANITE_CACHE_DIR");
+    struct cache cache = {0};
+    bool caching = false;
+    FILE *entry = NULL;
+    const char *server_path = NULL;
+    const char *connect_path = NULL;
+    struct driver driver = {0};
+    unsigned build_jobs = 0;
+    unsigned split = 0;
+    const char *split_prefix = NULL;
+    bool write_deps = false;
+    const char *deps_path = NULL;
+    const char *deps_target = NULL;
+    struct deps deps = {0};
+    struct str default_deps_path = {0};
+    const char *profile_path = NULL;
+    struct profile profile = {0};
+    bool line_directives = false;
+    const char *source_map_path = NULL;
+    int connect_first = 0;
+    int connect_next = 0;
+    int seen = 0;
+    int first = optind;
+    int opt;
+
+    *cacheable = false;
+    while ((opt = getopt_long(argc, argv, "slp:c:im:I:a:A:S:C:o:O::j:h", options, NULL)) != -1) {
+        seen++;
+        switch (opt) {
+        case 's':
+            stream = true;
+            break;
+        case 'l':
+            lazy_bodies = true;
+            break;
+        case 'p':
+            jobs = strtoul(optarg, NULL, 10);
+            if (jobs == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'c':
+            cache_dir = optarg;
+            break;
+        case 'i':
+            incremental = true;
+            lazy_bodies = true;
+            break;
+        case 'm':
+            interface_path = optarg;
+            ctx.module = true;
+            break;
+        case 'I':
+            interface_add_path(optarg);
+            break;
+        case 'a':
+            save_ast = optarg;
+            break;
+        case 'A':
+            load_ast = optarg;
+            break;
+        case 'S':
+            server_path = optarg;
+            break;
+        case 'C':
+            /* "-C path", "-Cpath", "--connect path" or "--connect=path", never grouped */
+            if (argv[first][1] != 'C' && argv[first][1] != '-') {
+                fprintf(stderr, "-C can't be grouped with other options!\n");
+                return 1;
+            }
+            connect_path = optarg;
+            connect_first = first;
+            connect_next = optind;
+            break;
+        case 'o':
+            driver.output = optarg;
+            driver.enabled = true;
+            break;
+        case 'b':
+            driver.object = true;
+            driver.enabled = true;
+            break;
+        case 'O':
+            driver.optimize = optarg != NULL ? optarg : "";
+            break;
+        case 'j':
+            build_jobs = strtoul(optarg, NULL, 10);
+            if (build_jobs == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'k':
+            split = strtoul(optarg, NULL, 10);
+            if (split == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'P':
+            split_prefix = optarg;
+            break;
+        case 'D':
+            write_deps = true;
+            deps_path = optarg;
+            break;
+        case 'T':
+            deps_target = optarg;
+            break;
+        case 'G':
+            codegen_instrument = true;
+            break;
+        case 'U':
+            profile_path = optarg;
+            break;
+        case 'F':
+            codegen_trace = true;
+            break;
+        case 'L':
+            line_directives = true;
+            break;
+        case 'M':
+            source_map_path = optarg;
+            break;
+        case 'B':
+            ctx.bench = codegen_bench = true;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+        first = optind;
+    }
+
+    int inputs = argc - optind;
+    if (inputs > 0) {
+        if (input != NULL || server_path != NULL || connect_path != NULL) {
+            fprintf(stderr, "input files can't be combined with --server or --connect!\n");
+            return 1;
+        }
+        if (load_ast != NULL) {
+            fprintf(stderr, "--load-ast can't be combined with input files!\n");
+            return 1;
+        }
+        if (inputs > 1 && (driver.output != NULL || interface_path != NULL || save_ast != NULL || source_map_path != NULL)) {
+            fprintf(stderr, "-o, -m, -a and --source-map write a single file, they can't be used with several inputs!\n");
+            return 1;
+        }
+
+        if (inputs > 1 && split_prefix != NULL) {
+            fprintf(stderr, "--split-prefix names a single set of files, it can't be used with several inputs!\n");
+            return 1;
+        }
+        if (inputs > 1 && deps_path != NULL) {
+            fprintf(stderr, "--deps=FILE names a single file, it can't be used with several inputs!\n");
+            return 1;
+        }
+
+        struct build build = { optind, argv, argv + optind, driver.output != NULL, driver.object,
+            split > 0 && split_prefix == NULL };
+        return jobs_run(inputs, build_jobs, _build, &build);
+    }
+
+    if ((server_path != NULL || connect_path != NULL) && input != NULL) {
+        fprintf(stderr, "--server and --connect can't be sent to a server!\n");
+        return 1;
+    }
+    if (server_path != NULL) {
+        /* workers start from the server's state, so it can't have options of its own */
+        if (seen > 1) {
+            fprintf(stderr, "--server takes no other options!\n");
+            return 1;
+        }
+        return server_run(server_path, compile, _warm_options);
+    }
+    if (connect_path != NULL) {
+        int count = 0;
+        char **args = _forwarded_args(argc, argv, connect_first, connect_next, &count);
+        int status = server_forward(connect_path, count, args);
+        free(args);
+        return status;
+    }
+
+    if (driver.optimize != NULL && !driver.enabled) {
+        fprintf(stderr, "-O only applies with -o or --compile!\n");
+        return 1;
+    }
+
+    if (split_prefix != NULL && split == 0) {
+        fprintf(stderr, "--split-prefix only applies with --split!\n");
+        return 1;
+    }
+    if (split > 0) {
+        if (stream || incremental || driver.enabled) {
+            fprintf(stderr, "--split can't be combined with -s, -i, -o or --compile!\n");
+            return 1;
+        }
+        if (split_prefix == NULL) {
+            fprintf(stderr, "--split needs --split-prefix when the input comes from stdin!\n");
+            return 1;
+        }
+    }
 
-    struct ast *parsed = parse();
-    struct ast *transformed = prepare(&ctx, parsed);
+    if (codegen_instrument && (stream || incremental || split > 0)) {
+        fprintf(stderr, "--instrument writes the counters out at the end of the C, it can't be combined with -s, -i or --split!\n");
+        return 1;
+    }
+    if (codegen_trace && (stream || incremental || split > 0)) {
+        fprintf(stderr, "--trace-functions names the functions at the end of the C, it can't be combined with -s, -i or --split!\n");
+        return 1;
+    }
+    if (ctx.bench && (stream || incremental || split > 0 || interface_path != NULL)) {
+        fprintf(stderr, "--bench adds the harness at the end of the C, it can't be combined with -s, -i, -m or --split!\n");
+        return 1;
+    }
+    if (source_map_path != NULL && (stream || incremental || split > 0 || driver.enabled)) {
+        fprintf(stderr, "--source-map maps the C as it is printed, it can't be combined with -s, -i, --split, -o or --compile!\n");
+        return 1;
+    }
+    if (profile_path != NULL && incremental) {
+        fprintf(stderr, "--use-profile can't be combined with -i, the C kept for a function has no hints!\n");
+        return 1;
+    }
 
-    struct str code = emit_c(transformed);
+    if (deps_target != NULL && !write_deps) {
+        fprintf(stderr, "--deps-target only applies with --deps!\n");
+        return 1;
+    }
+    if (write_deps) {
+        if (deps_target != NULL)
+            deps_add_target(&deps, deps_target);
+        _deps_targets(&deps, &driver, split, split_prefix, interface_path, save_ast, source_map_path);
+        if (deps_target == NULL && job_output == NULL && !driver.enabled && split == 0) {
+            fprintf(stderr, "--deps needs --deps-target when the C goes to stdout!\n");
+            return 1;
+        }
+        if (deps_path == NULL) {
+            default_deps_path = _sibling(deps.targets[0].str, ".d");
+            deps_path = default_deps_path.str;
+        }
+        if (job_input != NULL)
+            deps_add_source(&deps, job_input);
+        if (load_ast != NULL)
+            deps_add_source(&deps, load_ast);
+        if (profile_path != NULL)
+            deps_add_source(&deps, profile_path);
+    }
 
-    printf("%s", code.str);
-    return 0;
+    bool has_cache_dir = cache_dir != NULL && *cache_dir != '\0';
+    if (incremental && !has_cache_dir) {
+        fprintf(stderr, "--incremental needs a cache directory!\n");
+        return 1;
+    }
+
+    /* the map is made from the directives, they are only left in the C when asked for */
+    codegen_source_name = NULL;
+    if (line_directives || source_map_path != NULL)
+        codegen_source_name = job_input != NULL ? job_input : "<stdin>";
+
+    /* everything besides the input that changes the generated C, the directives name the input */
+    struct str_builder key = {0};
+    str_builder_printf(&key, "stream=%d lazy=%d incremental=%d module=%d instrument=%d trace=%d bench=%d lines=%s",
+        stream, lazy_bodies, incremental, ctx.module, codegen_instrument, codegen_trace, ctx.bench, line_directives ? codegen_source_name : "");
+    struct str options = str_builder_str(&key);
+
+    if (profile_path != NULL) {
+        if (!profile_read(&profile, profile_path))
+            return 1;
+        codegen_profile = &profile;
+    }
+
+    struct ast *parsed = NULL;
+    if (load_ast != NULL) {
+        /* without the source there is nothing to key the cached C by */
+        if ((parsed = ast_read(load_ast)) == NULL) {
+            fprintf(stderr, "unable to load tree %s!\n", load_ast);
+            return 1;
+        }
+    } else if (has_cache_dir) {
+        struct str source = input != NULL ? *input : str_read(stdin);
+        /* the cache holds what goes to stdout, split files and maps are written on the side, and the key has no profile */
+        caching = split == 0 && profile_path == NULL && source_map_path == NULL
+            && cache_init(&cache, cache_dir, options.str, source);
+        /* a hit skips the analysis the interface is written from, and the parse the tree is */
+        if (caching && interface_path == NULL && save_ast == NULL && cache_fetch(&cache, driver_out(&driver))) {
+            int status = driver_finish(&driver);
+            if (write_deps && status == 0 && !_write_deps(&deps, deps_path))
+                status = 1;
+            str_free(&default_deps_path);
+            str_free(&options);
+            return status;
+        }
+
+        struct str ast_path = {0};
+        if (caching) {
+            ast_path = ast_cache_path(cache_dir, source);
+            parsed = ast_read(ast_path.str);
+        }
+        if (parsed == NULL) {
+            parsed = parse_buffer(source, jobs);
+            if (parsed != NULL && ast_path.str != NULL)
+                ast_write(parsed, ast_path.str);
+        }
+        str_free(&ast_path);
+    } else if (input != NULL) {
+        parsed = parse_buffer(*input, jobs);
+    } else {
+        parsed = parse(jobs);
+    }
+
+    if (parsed == NULL || (save_ast != NULL && !ast_write(parsed, save_ast))) {
+        driver_cancel(&driver);
+        return 1;
+    }
+
+    /* the key only covers the input, not the interfaces it imports */
+    if (program_imports(parsed))
+        caching = false;
+    /* files written on the side aren't part of what a server keeps */
+    *cacheable = !program_imports(parsed) && interface_path == NULL && save_ast == NULL && load_ast == NULL
+        && !driver.enabled && split == 0 && !write_deps && profile_path == NULL && source_map_path == NULL;
+
+    if (stream || incremental) {
+        if (caching)
+            entry = cache_create(&cache);
+        if (incremental)
+            compile_incremental(&ctx, parsed, cache_dir, options.str, entry != NULL ? entry : driver_out(&driver));
+        else
+            compile_stream(&ctx, parsed, entry != NULL ? entry : driver_out(&driver));
+        if (entry != NULL)
+            cache_commit(&cache, entry, driver_out(&driver));
+    } else {
+        struct ast *transformed = prepare(&ctx, parsed);
+
+        if (split > 0) {
+            int status = emit_shards(transformed, split, split_prefix) ? 0 : 1;
+            if (interface_path != NULL && !interface_write(&ctx, parsed, interface_path))
+                return 1;
+            if (write_deps && status == 0 && !_write_deps(&deps, deps_path))
+                status = 1;
+            str_free(&default_deps_path);
+            str_free(&options);
+            profile_free(&profile);
+            codegen_profile = NULL;
+            return status;
+        }
+
+        struct str code = emit_c(transformed);
+        if (source_map_path != NULL && !source_map_write(source_map_path, &code, line_directives, job_output))
+            return 1;
+
+        fputs(code.str, driver_out(&driver));
+        if (caching && (entry = cache_create(&cache)) != NULL) {
+            fwrite(code.str, 1, code.size, entry);
+            cache_commit(&cache, entry, NULL);
+        }
+    }
+
+    int status = driver_finish(&driver);
+    if (interface_path != NULL && !interface_write(&ctx, parsed, interface_path))
+        return 1;
+    if (write_deps && status == 0 && !_write_deps(&deps, deps_path))
+        status = 1;
+    str_free(&default_deps_path);
+    str_free(&options);
+    profile_free(&profile);
+    codegen_profile = NULL;
+    return status;
+}
+
+int main(int argc, char **argv)
+{
+    bool cacheable = false;
+    return compile(argc, argv, NULL, &cacheable);
 }
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <str.h>
+#include <str_builder.h>
+#include <output.h>
+
+static bool _same(const char *a, const char *b)
+{
+    struct stat sa, sb;
+    if (stat(a, &sa) != 0 || stat(b, &sb) != 0 || sa.st_size != sb.st_size)
+        return false;
+
+    FILE *fa = fopen(a, "rb");
+    FILE *fb = fopen(b, "rb");
+    bool same = fa != NULL && fb != NULL;
+
+    char ba[1 << 16], bb[1 << 16];
+    while (same) {
+        size_t na = fread(ba, 1, sizeof(ba), fa);
+        size_t nb = fread(bb, 1, sizeof(bb), fb);
+        same = na == nb && memcmp(ba, bb, na) == 0 && !ferror(fa) && !ferror(fb);
+        if (na < sizeof(ba))
+            break;
+    }
+
+    if (fa != NULL)
+        fclose(fa);
+    if (fb != NULL)
+        fclose(fb);
+    return same;
+}
+
+bool output_commit(const char *tmp_path, const char *path)
+{
+    if (_same(tmp_path, path))
+        return remove(tmp_path) == 0;
+    return rename(tmp_path, path) == 0;
+}
+
+bool output_write(const char *path, struct str content)
+{
+    struct str_builder b = {0};
+    str_builder_printf(&b, "%s.%ld.tmp", path, (long)getpid());
+    struct str tmp_path = str_builder_str(&b);
+
+    bool written = false;
+    FILE *f = fopen(tmp_path.str, "wb");
+    if (f != NULL) {
+        if (content.size > 0)
+            fwrite(content.str, 1, content.size, f);
+        bool failed = ferror(f);
+        written = fclose(f) == 0 && !failed && output_commit(tmp_path.str, path);
+    }
+
+    if (!written) {
+        fprintf(stderr, "unable to write %s: %s\n", path, strerror(errno));
+        remove(tmp_path.str);
+    }
+    str_free(&tmp_path);
+    return written;
+}
@@ -3,21 +3,33 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <string.h>
+
 #include <ast.h>
 #include <str.h>
+#include <lazy.h>
+#include <split.h>
+#include <parser_state.h>
+#include <diagnostic.h>
 
+/* nested brackets still need one parser stack slot per level, let it grow on the heap */
+#define YYMAXDEPTH 10000000
 
-extern int yylineno;
-extern int yycolumn;
-extern int yyleng;
-extern int yycolumn;
-extern char *yytext;
-
-int yylex(void);
-int yyerror(const char *s);
-static struct ast *root;
+/* the whole input, when it is parsed from memory */
+static struct str source;
 %}
 
+%define api.pure full
+%locations
+%parse-param {struct parser_state *ps}
+%lex-param {struct parser_state *ps}
+
+%code {
+int yyerror(YYLTYPE *loc, struct parser_state *ps, const char *s);
+/* statements remember where they were written, for #line directives */
+static struct ast *_placed(struct ast *node, YYLTYPE loc);
+}
+
 
 %union {
     struct ast *node;
@@ -26,6 +38,8 @@ static struct ast *root;
     char ch;
     uint64_t num;
     double dec;
+    struct ast_list list;
+    struct source_range range;
 }
 
 %token <num> INT_TOK
@@ -33,36 +47,61 @@ static struct ast *root;
 %token <str> IDENTIFIER_TOK STRING_TOK
 %token <ch> CHAR_TOK
 %token <boolean> BOOL_TOK
+%token <range> LAZY_BODY_TOK
 %type <node> program statements statement expr ident vars type pointer_type fns fn_args body call_args value unary 
 %type <node> if_cond elsif_branch else_branch fors ident_chain whiles expr1 field_access assignment
+%type <list> statement_list ident_list call_arg_list fn_arg_list
+%type <num> annotations annotation annotation_list
 
 %token IF_TOK UNLESS_TOK ELSE_TOK ELSIF_TOK FOR_TOK WHILE_TOK UNTIL_TOK BREAK_TOK NEXT_TOK CASE_TOK WHEN_TOK DEF_TOK
 %token FUN_TOK SIZEOF_TOK BEGIN_TOK RETURN_TOK LOOP_TOK RESCUE_TOK THEN_TOK DO_TOK END_TOK WITH_TOK AUTO_TOK
-
-%left '+' INCREMENT_TOK '-' DECREMENT_TOK '*' '/' FLOOR_DIV_TOK '%' '~' '&' '|' '^' PIPE_FORWARD_TOK
-%left LEFT_SHIFT_TOK RIGHT_SHIFT_TOK '.' AS_TOK SPLAT_TOK RANGE_TOK
-%left EQL_TOK '!' NOT_EQL_TOK AND_TOK OR_TOK '<' LESS_THAN_EQL_TOK '>' MORE_THAN_EQL_TOK
-%right '=' ADD_ASSIGN_TOK SUB_ASSIGN_TOK MUL_ASSIGN_TOK DIV_ASSIGN_TOK FLOOR_DIV_ASSIGN_TOK MOD_ASSIGN_TOK
-%right BIT_NOT_ASSIGN_TOK BIT_AND_ASSIGN_TOK BIT_OR_ASSIGN_TOK XOR_ASSIGN_TOK
-%right LEFT_SHIFT_ASSIGN_TOK RIGHT_SHIFT_ASSIGN_TOK
+%token BODY_START_TOK IMPORT_TOK BENCH_TOK
+
+/* lowest to highest, binary operators follow C */
+%right '=' ADD_ASSIGN_TOK SUB_ASSIGN_TOK MUL_ASSIGN_TOK DIV_ASSIGN_TOK FLOOR_DIV_ASSIGN_TOK MOD_ASSIGN_TOK BIT_NOT_ASSIGN_TOK BIT_AND_ASSIGN_TOK BIT_OR_ASSIGN_TOK XOR_ASSIGN_TOK LEFT_SHIFT_ASSIGN_TOK RIGHT_SHIFT_ASSIGN_TOK
+%left PIPE_FORWARD_TOK
+%left OR_TOK
+%left AND_TOK
+%left '|'
+%left '^'
+%left '&'
+%left EQL_TOK NOT_EQL_TOK
+%left '<' LESS_THAN_EQL_TOK '>' MORE_THAN_EQL_TOK
+%left LEFT_SHIFT_TOK RIGHT_SHIFT_TOK
+%left '+' '-'
+%left '*' '/' FLOOR_DIV_TOK '%'
+%left AS_TOK
+%right '!' '~'
+%left INCREMENT_TOK DECREMENT_TOK '.'
+%nonassoc SPLAT_TOK RANGE_TOK
 
 %%
 program:
-    statements                      { root = program_node($1); }
+    statements                      { ps->root = program_node($1); }
+    | BODY_START_TOK statements     { ps->root = $2;               }
     ;
 
 statements:
-    statement statements            { $$ = statement_node($2, $1); }
-    | expr ';' statements           { $$ = statement_node($3, $1); }
-    |                               { $$ = NULL;                   }
+    statement_list                  { $$ = $1.head; }
+    |                               { $$ = NULL;    }
+    ;
+
+statement_list:
+    statement                       { $$ = statement_list_append((struct ast_list){0}, _placed($1, @1)); }
+    | expr ';'                      { $$ = statement_list_append((struct ast_list){0}, _placed($1, @1)); }
+    | statement_list statement      { $$ = statement_list_append($1, _placed($2, @2));                   }
+    | statement_list expr ';'       { $$ = statement_list_append($1, _placed($2, @2));                   }
     ;
 
 statement:
     vars ';'                        { $$ = $1; }
     | fns                           { $$ = $1; }
+    | annotations fns               { $$ = annotate_fn_node($2, $1); }
     | if_cond                       { $$ = $1; }
     | fors                          { $$ = $1; }
     | whiles                        { $$ = $1; }
+    | IMPORT_TOK STRING_TOK ';'     { $$ = import_node($2); }
+    | BENCH_TOK STRING_TOK DO_TOK body END_TOK { $$ = bench_node($2, $4); }
     ;
 
 whiles:
@@ -72,9 +111,14 @@ whiles:
     ;
 
 ident_chain:
-    ident                           { $$ = identifier_chain_node(NULL, $1); }
-    | ident ',' ident_chain         { $$ = identifier_chain_node($3, $1);   }
-    |                               { $$ = NULL;                            }
+    ident_list                      { $$ = $1.head; }
+    | ident_list ','                { $$ = $1.head; }
+    |                               { $$ = NULL;    }
+    ;
+
+ident_list:
+    ident                           { $$ = identifier_chain_append((struct ast_list){0}, $1); }
+    | ident_list ',' ident          { $$ = identifier_chain_append($1, $3);                   }
     ;
 
 fors:
@@ -103,16 +147,39 @@ else_branch:
     ;
 
 fns:
-    DEF_TOK ident '(' fn_args ')' body END_TOK            { $$ = fn_def_node(type_node(NULL), $2, $4, $6, 0); }
-    | DEF_TOK ident '(' fn_args ')' ':' type body END_TOK { $$ = fn_def_node(type_node($7), $2, $4, $8, 0);   }
-    | FUN_TOK ident '(' fn_args ')' body END_TOK          { $$ = fn_def_node(type_node(NULL), $2, $4, $6, 1); }
-    | FUN_TOK ident '(' fn_args ')' ':' type body END_TOK { $$ = fn_def_node(type_node($7), $2, $4, $8, 1);   }
+    DEF_TOK ident '(' fn_args ')' body END_TOK                     { $$ = fn_def_node(type_node(NULL), $2, $4, $6, 0); }
+    | DEF_TOK ident '(' fn_args ')' ':' type body END_TOK          { $$ = fn_def_node(type_node($7), $2, $4, $8, 0);   }
+    | FUN_TOK ident '(' fn_args ')' body END_TOK                   { $$ = fn_def_node(type_node(NULL), $2, $4, $6, 1); }
+    | FUN_TOK ident '(' fn_args ')' ':' type body END_TOK          { $$ = fn_def_node(type_node($7), $2, $4, $8, 1);   }
+    | DEF_TOK ident '(' fn_args ')' LAZY_BODY_TOK END_TOK          { $$ = fn_def_node(type_node(NULL), $2, $4, lazy_body_node($6), 0); }
+    | DEF_TOK ident '(' fn_args ')' ':' type LAZY_BODY_TOK END_TOK { $$ = fn_def_node(type_node($7), $2, $4, lazy_body_node($8), 0);   }
+    | FUN_TOK ident '(' fn_args ')' LAZY_BODY_TOK END_TOK          { $$ = fn_def_node(type_node(NULL), $2, $4, lazy_body_node($6), 1); }
+    | FUN_TOK ident '(' fn_args ')' ':' type LAZY_BODY_TOK END_TOK { $$ = fn_def_node(type_node($7), $2, $4, lazy_body_node($8), 1);   }
+    ;
+
+annotations:
+    annotation                      { $$ = $1;      }
+    | annotations annotation        { $$ = $1 | $2; }
+    ;
+
+annotation:
+    '@' '[' annotation_list ']'     { $$ = $3; }
+    ;
+
+annotation_list:
+    IDENTIFIER_TOK                       { $$ = fn_attribute($1.str); ast_str_free(&$1); if ($$ == 0) { yyerror(&yylloc, ps, "unknown annotation"); YYERROR; } }
+    | annotation_list ',' IDENTIFIER_TOK { $$ = fn_attribute($3.str); ast_str_free(&$3); if ($$ == 0) { yyerror(&yylloc, ps, "unknown annotation"); YYERROR; } $$ |= $1; }
     ;
 
 call_args:
-    expr                            { $$ = fn_arg_list_node(NULL, $1); }
-    | expr ',' call_args            { $$ = fn_arg_list_node($3, $1);   }
-    |                               { $$ = NULL; }
+    call_arg_list                   { $$ = $1.head; }
+    | call_arg_list ','             { $$ = $1.head; }
+    |                               { $$ = NULL;    }
+    ;
+
+call_arg_list:
+    expr                            { $$ = fn_arg_list_append((struct ast_list){0}, $1); }
+    | call_arg_list ',' expr        { $$ = fn_arg_list_append($1, $3);                   }
     ;
 
 body:
@@ -120,10 +187,16 @@ body:
     ;
 
 fn_args:
-    vars                            { $$ = fn_arg_list_node(NULL, $1);              }
-    | SPLAT_TOK                     { $$ = fn_arg_list_node(NULL, variadic_node()); }
-    | vars ',' fn_args              { $$ = fn_arg_list_node($3, $1);                }
-    |                               { $$ = NULL;                                    }
+    fn_arg_list                     { $$ = $1.head;                                              }
+    | fn_arg_list ','               { $$ = $1.head;                                              }
+    | fn_arg_list ',' SPLAT_TOK     { $$ = fn_arg_list_append($1, variadic_node()).head;         }
+    | SPLAT_TOK                     { $$ = fn_arg_list_node(NULL, variadic_node());              }
+    |                               { $$ = NULL;                                                 }
+    ;
+
+fn_arg_list:
+    vars                            { $$ = fn_arg_list_append((struct ast_list){0}, $1); }
+    | fn_arg_list ',' vars          { $$ = fn_arg_list_append($1, $3);                   }
     ;
 
 vars:
@@ -241,11 +314,73 @@ expr1:
 %%
 
 
-struct ast *parse() {
-    yyparse();
-    return root;
+/* parses a range of the loaded source, either as a program or as a function body */
+static struct ast *_parse_source(struct source_range range, bool body) {
+    struct parser_state ps = {0};
+
+    lex_begin(&ps, source.str + range.offset, range.length, range.offset, range.line);
+    ps.body_start = body;
+    int failed = yyparse(&ps);
+    lex_end(&ps);
+
+    return failed ? NULL : ps.root;
+}
+
+struct ast *parse(unsigned jobs) {
+    if (!lazy_bodies && jobs <= 1) {
+        struct parser_state ps = {0};
+
+        lex_begin(&ps, NULL, 0, 0, 1);
+        yyparse(&ps);
+        lex_end(&ps);
+        return ps.root;
+    }
+
+    return parse_buffer(str_read(stdin), jobs);
+}
+
+/* the parser keeps the buffer, lazy bodies are parsed from it later */
+struct ast *parse_buffer(struct str buffer, unsigned jobs) {
+    source = buffer;
+    if (jobs > 1)
+        return parse_split(source.str, source.size, jobs);
+    return parse_chunk((struct source_range){ 0, source.size, 1 });
+}
+
+/* what lazy bodies point into, empty unless the input was parsed from memory */
+struct str parse_source(void) {
+    return source;
+}
+
+/* for trees that were loaded instead of parsed, the buffer their lazy bodies point into */
+void parse_use_source(struct str buffer) {
+    source = buffer;
+}
+
+/* safe to call from several threads at once, the source is only read */
+struct ast *parse_chunk(struct source_range range) {
+    return _parse_source(range, false);
+}
+
+/* parses a body the lazy token filter skipped, replacing the node in place */
+void parse_lazy_body(struct ast *node) {
+    struct source_range range = node->u.lazy_body;
+    struct ast *body = _parse_source(range, true);
+
+    if (body == NULL) {
+        fatal("could not parse the body of the function at line %d!", range.line);
+    }
+
+    *node = *body;
+    free_node_shell(body);
+}
+
+static struct ast *_placed(struct ast *node, YYLTYPE loc) {
+    node->span = (struct source_span){ loc.first_line, loc.first_column, loc.last_line, loc.last_column };
+    return node;
 }
 
-int yyerror(const char *s) {
-    return fprintf(stderr, "Error at line (%d:%d): %s: '%s'\n", yylineno, yycolumn - yyleng, s, yytext);
+int yyerror(YYLTYPE *loc, struct parser_state *ps, const char *s) {
+    report(TANZANITE_ERROR, loc->first_line, loc->first_column, "%s: '%s'", s, lex_text(ps));
+    return 0;
 }
@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include <profile.h>
+
+static bool _read_counts(struct profile *p, char *line)
+{
+    char *save = NULL;
+    char *name = strtok_r(line, " \n", &save);
+    char *count = strtok_r(NULL, " \n", &save);
+    if (name == NULL || count == NULL)
+        return false;
+
+    struct profile_counts c = { .count = strtoull(count, NULL, 10) };
+    c.counts = calloc(c.count > 0 ? c.count : 1, sizeof(*c.counts));
+    for (size_t i = 0; i < c.count; i++) {
+        char *value = strtok_r(NULL, " \n", &save);
+        if (value == NULL) {
+            free(c.counts);
+            return false;
+        }
+        c.counts[i] = strtoull(value, NULL, 10);
+    }
+
+    /* a name seen twice keeps its last counts */
+    uint32_t it = profile_store_find(&p->functions, name);
+    if (hash_exists(&p->functions, it)) {
+        free(hash_value(&p->functions, it).counts);
+    } else {
+        it = profile_store_insert(&p->functions, strdup(name));
+    }
+    hash_value(&p->functions, it) = c;
+    if (c.count > 0)
+        p->calls += c.counts[0];
+    return true;
+}
+
+bool profile_read(struct profile *p, const char *path)
+{
+    memset(p, 0, sizeof(*p));
+
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "unable to read profile %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    char *line = NULL;
+    size_t size = 0;
+    bool ok = getline(&line, &size, in) > 0 && strncmp(line, PROFILE_HEADER "\n", sizeof(PROFILE_HEADER)) == 0;
+    while (ok && getline(&line, &size, in) > 0)
+        ok = _read_counts(p, line);
+
+    free(line);
+    fclose(in);
+    if (!ok) {
+        fprintf(stderr, "%s isn't a profile written by an instrumented program!\n", path);
+        profile_free(p);
+    }
+    return ok;
+}
+
+const struct profile_counts *profile_find(struct profile *p, const char *name)
+{
+    uint32_t it = profile_store_find(&p->functions, name);
+    return hash_exists(&p->functions, it) ? &hash_value(&p->functions, it) : NULL;
+}
+
+void profile_free(struct profile *p)
+{
+    for (uint32_t it = hash_begin(&p->functions); it < hash_end(&p->functions); it++) {
+        if (!hash_exists(&p->functions, it))
+            continue;
+
+        free((char *)hash_key(&p->functions, it));
+        free(hash_value(&p->functions, it).counts);
+    }
+    profile_store_free(&p->functions);
+    memset(p, 0, sizeof(*p));
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <ast.h>
+#include <str.h>
+#include <str_builder.h>
+#include <cache.h>
+#include <query.h>
+#include <analyzer.h>
+#include <codegen.h>
+#include <diagnostic.h>
+#include <hash/query_store.h>
+#include <hash/fingerprint_store.h>
+
+/* bump when the layout of records or the C generated for a body changes */
+#define QUERY_FORMAT "tanzanite-query-2"
+
+struct query_db {
+    struct analyzer_context *ctx;
+    const char *dir;
+    const char *options;
+
+    struct query_store results;
+    /* memoized fingerprints of the current program */
+    struct fingerprint_store signatures;
+    struct fingerprint_store globals;
+};
+
+static void _type_fingerprint(struct str_builder *b, struct analyzable_type *type)
+{
+    str_builder_printf(b, "%s %zu\n", type->identifier.str, type->pointer_depth);
+}
+
+static const char *_memoize(struct fingerprint_store *store, const char *name, struct str_builder *b)
+{
+    struct str data = str_builder_str(b);
+    uint32_t it = fingerprint_store_insert(store, strdup(name));
+
+    cache_key(hash_value(store, it).hex, "", data.str, data.size);
+    str_free(&data);
+    return hash_value(store, it).hex;
+}
+
+/* everything about a function its callers' checked bodies depend on */
+static const char *_signature(struct query_db *db, const char *name)
+{
+    uint32_t it = fingerprint_store_find(&db->signatures, name);
+    if (hash_exists(&db->signatures, it))
+        return hash_value(&db->signatures, it).hex;
+
+    struct str_builder b = {0};
+    it = function_store_find(&db->ctx->functions, name);
+    if (!hash_exists(&db->ctx->functions, it)) {
+        str_builder_append_cstr(&b, "missing");
+        return _memoize(&db->signatures, name, &b);
+    }
+
+    struct analyzable_function *fn = &hash_value(&db->ctx->functions, it);
+    _type_fingerprint(&b, &fn->return_type);
+    /* attributes and linkage are part of the emitted definition */
+    str_builder_printf(&b, "%d %d %u %d\n", fn->variadic, fn->immutable, fn->attributes, fn->exported);
+    for (size_t i = 0; i < fn->args_count; i++) {
+        struct analyzable_fn_arg *arg = fn->args + i;
+        str_builder_printf(&b, "%s ", arg->identifier.str);
+        _type_fingerprint(&b, &arg->type);
+
+        /* defaults are copied into every call */
+        if (arg->default_value != NULL) {
+            struct str code = emit_c_statement(arg->default_value);
+            str_builder_append_str(&b, code);
+            str_free(&code);
+        }
+    }
+
+    return _memoize(&db->signatures, name, &b);
+}
+
+static const char *_global(struct query_db *db, const char *name)
+{
+    uint32_t it = fingerprint_store_find(&db->globals, name);
+    if (hash_exists(&db->globals, it))
+        return hash_value(&db->globals, it).hex;
+
+    struct str_builder b = {0};
+    struct var_store_hash *globals = &stack_value(&db->ctx->variables, stack_bottom(&db->ctx->variables));
+    it = var_store_hash_find(globals, name);
+    if (hash_exists(globals, it))
+        _type_fingerprint(&b, &hash_value(globals, it).type);
+    else
+        str_builder_append_cstr(&b, "missing");
+
+    return _memoize(&db->globals, name, &b);
+}
+
+static const char *_fingerprint(struct query_db *db, enum query_kind kind, const char *name)
+{
+    return kind == QUERY_SIGNATURE ? _signature(db, name) : _global(db, name);
+}
+
+static void _add_dep(struct query_db *db, struct query_result *res, enum query_kind kind, const char *name)
+{
+    for (size_t i = 0; i < res->deps_count; i++) {
+        if (res->deps[i].kind == kind && strcmp(res->deps[i].name, name) == 0)
+            return;
+    }
+
+    res->deps = realloc(res->deps, (res->deps_count + 1) * sizeof(*res->deps));
+    struct query_dep *dep = res->deps + res->deps_count++;
+    dep->kind = kind;
+    dep->name = strdup(name);
+    strcpy(dep->fingerprint, _fingerprint(db, kind, name));
+}
+
+/* the body is part of the key, so inputs sharing the directory keep their own main and helpers */
+static struct str _record_path(struct query_db *db, const char *name, struct query_result *res, const char *suffix)
+{
+    char key[CACHE_KEY_SIZE];
+    struct str_builder b = {0};
+
+    str_builder_printf(&b, "%s %s", res->body, name);
+    cache_key(key, db->options, b.buffer.str, b.buffer.size);
+    str_builder_deinit(&b);
+    str_builder_printf(&b, "%s/%s.q%s", db->dir, key, suffix);
+    return str_builder_str(&b);
+}
+
+static bool _read_name(FILE *f, struct str *name)
+{
+    struct str_builder b = {0};
+    int c = 0;
+
+    while ((c = fgetc(f)) != EOF && c != '\n')
+        str_builder_append_char(&b, c);
+
+    *name = str_builder_str(&b);
+    return name->str != NULL;
+}
+
+/* a record is only used when the body and every input it depends on are unchanged */
+static bool _load(struct query_db *db, const char *name, struct query_result *res)
+{
+    struct str path = _record_path(db, name, res, "");
+    FILE *f = fopen(path.str, "rb");
+    str_free(&path);
+    if (f == NULL)
+        return false;
+
+    char format[32] = {0};
+    char body[CACHE_KEY_SIZE] = {0};
+    size_t count = 0;
+    bool valid = fscanf(f, "%31s %64s %zu\n", format, body, &count) == 3
+        && strcmp(format, QUERY_FORMAT) == 0
+        && strcmp(body, res->body) == 0;
+
+    for (size_t i = 0; valid && i < count; i++) {
+        char kind = 0;
+        char fingerprint[CACHE_KEY_SIZE] = {0};
+        struct str dep = {0};
+
+        valid = fscanf(f, "%c %64s ", &kind, fingerprint) == 2
+            && (kind == QUERY_SIGNATURE || kind == QUERY_GLOBAL)
+            && _read_name(f, &dep)
+            && strcmp(_fingerprint(db, kind, dep.str), fingerprint) == 0;
+
+        if (valid) {
+            res->deps = realloc(res->deps, (res->deps_count + 1) * sizeof(*res->deps));
+            res->deps[res->deps_count] = (struct query_dep){ kind, dep.str, {0} };
+            strcpy(res->deps[res->deps_count++].fingerprint, fingerprint);
+        } else {
+            str_free(&dep);
+        }
+    }
+
+    size_t size = 0;
+    if (valid && fscanf(f, "%zu", &size) == 1 && fgetc(f) == '\n') {
+        res->code.str = malloc(size + 1);
+        res->code.size = fread(res->code.str, 1, size, f);
+        res->code.str[res->code.size] = '\0';
+        valid = res->code.size == size;
+    } else {
+        valid = false;
+    }
+
+    fclose(f);
+
+    if (!valid) {
+        for (size_t i = 0; i < res->deps_count; i++)
+            free(res->deps[i].name);
+        free(res->deps);
+        str_free(&res->code);
+        res->deps = NULL;
+        res->deps_count = 0;
+    }
+
+    return valid;
+}
+
+static void _store(struct query_db *db, const char *name, struct query_result *res, struct str code)
+{
+    struct str path = _record_path(db, name, res, "");
+    struct str_builder b = {0};
+    str_builder_printf(&b, ".%ld.tmp", (long)getpid());
+    struct str suffix = str_builder_str(&b);
+    struct str tmp_path = _record_path(db, name, res, suffix.str);
+
+    FILE *f = fopen(tmp_path.str, "wb");
+    if (f != NULL) {
+        fprintf(f, "%s %s %zu\n", QUERY_FORMAT, res->body, res->deps_count);
+        for (size_t i = 0; i < res->deps_count; i++)
+            fprintf(f, "%c %s %s\n", res->deps[i].kind, res->deps[i].fingerprint, res->deps[i].name);
+        fprintf(f, "%zu\n", (size_t)code.size);
+        fwrite(code.str, 1, code.size, f);
+
+        bool failed = ferror(f);
+        if (fclose(f) != 0 || failed || rename(tmp_path.str, path.str) != 0)
+            remove(tmp_path.str);
+    }
+
+    str_free(&tmp_path);
+    str_free(&suffix);
+    str_free(&path);
+}
+
+static void _check(struct query_db *db, struct analyzable_function *fn)
+{
+    struct analyzer_context *ctx = db->ctx;
+    uint32_t it = query_store_insert(&db->results, fn->name.str);
+    struct query_result *res = &hash_value(&db->results, it);
+    memset(res, 0, sizeof(*res));
+
+    if (fn->body->type != LAZY_BODY) {
+        fatal("incremental compilation expects unparsed bodies!");
+    }
+    struct source_range range = fn->body->u.lazy_body;
+    /* #line directives in the stored C name absolute lines, they go stale once the body moves */
+    char line[32] = "";
+    if (codegen_source_name != NULL)
+        snprintf(line, sizeof(line), "line=%d", range.line);
+    cache_key(res->body, line, parse_source().str + range.offset, range.length);
+
+    if (_load(db, fn->name.str, res)) {
+        fn->checked = true;
+        res->reused = true;
+        for (size_t i = 0; i < res->deps_count; i++) {
+            if (res->deps[i].kind == QUERY_SIGNATURE)
+                fn_call_queue_push(&ctx->call_queue, res->deps[i].name);
+        }
+        return;
+    }
+
+    /* whatever gets queued or read while checking is what the body depends on */
+    struct fn_call_queue pending = ctx->call_queue;
+    ctx->call_queue = (struct fn_call_queue){0};
+    ctx->record_globals = true;
+    prepare_function(ctx, fn->name.str);
+    ctx->record_globals = false;
+
+    _add_dep(db, res, QUERY_SIGNATURE, fn->name.str);
+
+    const char *name = NULL;
+    while ((name = fn_call_queue_pop(&ctx->call_queue)) != NULL) {
+        _add_dep(db, res, QUERY_SIGNATURE, name);
+        fn_call_queue_push(&pending, name);
+    }
+    while ((name = global_read_queue_pop(&ctx->global_reads)) != NULL)
+        _add_dep(db, res, QUERY_GLOBAL, name);
+
+    ctx->call_queue = pending;
+}
+
+static void _free_fingerprints(struct fingerprint_store *store)
+{
+    for (uint32_t it = hash_begin(store); it < hash_end(store); it++) {
+        if (hash_exists(store, it))
+            free((char *)hash_key(store, it));
+    }
+    fingerprint_store_free(store);
+}
+
+void compile_incremental(struct analyzer_context *ctx, struct ast *program, const char *dir, const char *options, FILE *out)
+{
+    struct query_db db = { .ctx = ctx, .dir = dir, .options = options };
+
+    prepare_globals(ctx, program);
+
+    const char *name = NULL;
+    while ((name = fn_call_queue_pop(&ctx->call_queue)) != NULL) {
+        uint32_t it = function_store_find(&ctx->functions, name);
+        struct analyzable_function *fn = &hash_value(&ctx->functions, it);
+
+        if (fn->checked)
+            continue;
+        if (fn->body == NULL)
+            prepare_function(ctx, name);
+        else
+            _check(&db, fn);
+    }
+
+    struct ast *iter = program->u.program;
+    while (iter != NULL) {
+        struct ast *stmt = iter->u.statement.current;
+        struct query_result *res = NULL;
+
+        if (stmt->type == ANALYZE_FN && !stmt->u.a_fn.declaration) {
+            uint32_t it = query_store_find(&db.results, stmt->u.a_fn.name.str);
+            if (hash_exists(&db.results, it))
+                res = &hash_value(&db.results, it);
+        }
+
+        if (res != NULL && res->reused) {
+            fwrite(res->code.str, 1, res->code.size, out);
+        } else {
+            struct str code = emit_c_statement(stmt);
+            if (res != NULL)
+                _store(&db, stmt->u.a_fn.name.str, res, code);
+            if (code.str != NULL)
+                fwrite(code.str, 1, code.size, out);
+            str_free(&code);
+        }
+
+        iter = iter->u.statement.next;
+    }
+
+    for (uint32_t it = hash_begin(&db.results); it < hash_end(&db.results); it++) {
+        if (!hash_exists(&db.results, it))
+            continue;
+
+        struct query_result *res = &hash_value(&db.results, it);
+        for (size_t i = 0; i < res->deps_count; i++)
+            free(res->deps[i].name);
+        free(res->deps);
+        str_free(&res->code);
+    }
+    _free_fingerprints(&db.signatures);
+    _free_fingerprints(&db.globals);
+    query_store_free(&db.results);
+
+    var_store_pop_frame(&ctx->variables);
+}
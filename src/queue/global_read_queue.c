@@ -0,0 +1,7 @@
+#include <stdlib.h>
+#include <string.h>
+#include <queue.h>
+
+#include <queue/global_read_queue.h>
+
+QUEUE_IMPL(global_read_queue, const char*);
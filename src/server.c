@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#include <str.h>
+#include <str_builder.h>
+#include <cache.h>
+#include <server.h>
+#include <interface.h>
+#include <diagnostic.h>
+#include <tanzanite.h>
+#include <hash/result_store.h>
+
+/* bump when the messages change */
+#define SERVER_PROTOCOL 1
+/* past this many results the server starts over instead of growing without bound */
+#define SERVER_RESULTS_MAX 4096
+#define SERVER_ARGS_MAX 1024
+/* analyzed programs kept for requests that only change the C */
+#define SERVER_CONTEXTS 8
+
+/*
+ * A request is the protocol version, the client's working directory and
+ * $TANZANITE_CACHE_DIR, its arguments and its input. The answer is the exit
+ * status and what the compile wrote to stdout and stderr. Integers are sent
+ * in host byte order, client and server always share a machine.
+ */
+struct server_request {
+    struct str cwd;
+    struct str cache_dir;
+    int argc;
+    char **argv;
+    struct str input;
+};
+
+static bool _write_all(int fd, const void *data, size_t size)
+{
+    const char *p = data;
+
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool _read_all(int fd, void *data, size_t size)
+{
+    char *p = data;
+
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool _write_str(int fd, struct str s)
+{
+    uint64_t size = s.size;
+    return _write_all(fd, &size, sizeof(size)) && _write_all(fd, s.str, s.size);
+}
+
+static bool _read_str(int fd, struct str *s, uint64_t max)
+{
+    uint64_t size = 0;
+    if (!_read_all(fd, &size, sizeof(size)) || size > max)
+        return false;
+
+    s->str = malloc(size + 1);
+    s->size = size;
+    s->str[size] = '\0';
+    return _read_all(fd, s->str, size);
+}
+
+static struct str _cstr(const char *s)
+{
+    return (struct str){ (char *)s, s != NULL ? strlen(s) : 0 };
+}
+
+static void _free_request(struct server_request *req)
+{
+    str_free(&req->cwd);
+    str_free(&req->cache_dir);
+    for (int i = 0; i < req->argc; i++)
+        free(req->argv[i]);
+    free(req->argv);
+    str_free(&req->input);
+}
+
+static bool _read_request(int fd, struct server_request *req)
+{
+    uint32_t protocol = 0;
+    uint32_t argc = 0;
+
+    if (!_read_all(fd, &protocol, sizeof(protocol)) || protocol != SERVER_PROTOCOL)
+        return false;
+    if (!_read_str(fd, &req->cwd, PATH_MAX) || !_read_str(fd, &req->cache_dir, PATH_MAX))
+        return false;
+    if (!_read_all(fd, &argc, sizeof(argc)) || argc == 0 || argc > SERVER_ARGS_MAX)
+        return false;
+
+    req->argv = calloc(argc + 1, sizeof(*req->argv));
+    for (; req->argc < (int)argc; req->argc++) {
+        struct str arg = {0};
+        bool read = _read_str(fd, &arg, PATH_MAX);
+        req->argv[req->argc] = arg.str;
+        if (!read)
+            return false;
+    }
+
+    return _read_str(fd, &req->input, UINT32_MAX);
+}
+
+/* everything a request's output can depend on when it's cacheable */
+static void _request_key(struct server_request *req, char key[CACHE_KEY_SIZE])
+{
+    struct str_builder b = {0};
+
+    str_builder_append_str(&b, req->cwd);
+    str_builder_append_char(&b, '\n');
+    str_builder_append_str(&b, req->cache_dir);
+    for (int i = 1; i < req->argc; i++) {
+        str_builder_append_char(&b, '\n');
+        str_builder_append_cstr(&b, req->argv[i]);
+    }
+
+    struct str options = str_builder_str(&b);
+    cache_key(key, options.str, req->input.str, req->input.size);
+    str_free(&options);
+}
+
+static struct str _slurp(FILE *f)
+{
+    rewind(f);
+    return str_read(f);
+}
+
+/* what runs in the server itself can't abort() or change the process, everything else gets a worker */
+static struct server_result _run(struct server_request *req, server_compile compile, bool *cacheable)
+{
+    struct server_result res = {0};
+    FILE *out = tmpfile();
+    FILE *err = tmpfile();
+    int flag[2];
+
+    if (out == NULL || err == NULL || pipe(flag) != 0) {
+        fprintf(stderr, "unable to start a worker: %s\n", strerror(errno));
+        abort();
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(flag[0]);
+        dup2(fileno(out), STDOUT_FILENO);
+        dup2(fileno(err), STDERR_FILENO);
+
+        if (chdir(req->cwd.str) != 0) {
+            fprintf(stderr, "%s: %s\n", req->cwd.str, strerror(errno));
+            exit(1);
+        }
+        if (req->cache_dir.size > 0)
+            setenv("TANZANITE_CACHE_DIR", req->cache_dir.str, 1);
+        else
+            unsetenv("TANZANITE_CACHE_DIR");
+
+        /* the server already ran getopt, start over for the request's arguments */
+        optind = 0;
+        bool worker_cacheable = false;
+        int status = compile(req->argc, req->argv, &req->input, &worker_cacheable);
+
+        fflush(stdout);
+        fflush(stderr);
+        if (!_write_all(flag[1], &worker_cacheable, sizeof(worker_cacheable)))
+            status = 1;
+        exit(status);
+    }
+
+    close(flag[1]);
+    int status = 0;
+    while (pid > 0 && waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+
+    /* a worker that died before reporting never gets cached */
+    *cacheable = false;
+    if (pid > 0 && WIFEXITED(status)) {
+        res.status = WEXITSTATUS(status);
+        _read_all(flag[0], cacheable, sizeof(*cacheable));
+    } else {
+        res.status = pid > 0 ? 128 + WTERMSIG(status) : 1;
+    }
+    close(flag[0]);
+
+    res.out = _slurp(out);
+    res.err = _slurp(err);
+    fclose(out);
+    fclose(err);
+    return res;
+}
+
+/* a context and the source and analysis options its program was analyzed with */
+struct server_context {
+    struct tanzanite *tz;
+    char key[CACHE_KEY_SIZE];
+    /* the key is that of the program in tz, which imports nothing */
+    bool analyzed;
+    uint64_t used;
+};
+
+struct server_state {
+    struct result_store results;
+    struct server_context contexts[SERVER_CONTEXTS];
+    uint64_t clock;
+    server_compile compile;
+    server_options options;
+};
+
+static void _context_key(char key[CACHE_KEY_SIZE], const struct tanzanite_options *options, struct str input)
+{
+    char analysis[64];
+    snprintf(analysis, sizeof(analysis), "lazy=%d module=%d bench=%d", options->lazy, options->module, options->bench);
+    cache_key(key, analysis, input.str, input.size);
+}
+
+/* the context analyzed from the same source with the same options, or the one used the longest ago */
+static struct server_context *_context(struct server_state *state, const char key[CACHE_KEY_SIZE], bool *analyzed)
+{
+    struct server_context *oldest = state->contexts;
+
+    for (size_t i = 0; i < SERVER_CONTEXTS; i++) {
+        struct server_context *c = state->contexts + i;
+        if (c->analyzed && strcmp(c->key, key) == 0) {
+            *analyzed = true;
+            return c;
+        }
+        if (c->used < oldest->used)
+            oldest = c;
+    }
+
+    *analyzed = false;
+    if (oldest->tz == NULL)
+        oldest->tz = tanzanite_new();
+    return oldest;
+}
+
+/* the compile a worker would do, with stdout and stderr already pointing at the answer */
+static int _compile_warm(struct server_state *state, struct server_request *req, struct server_warm *warm, bool *cacheable)
+{
+    char key[CACHE_KEY_SIZE];
+    _context_key(key, &warm->options, req->input);
+
+    bool analyzed = false;
+    struct server_context *c = _context(state, key, &analyzed);
+    c->used = ++state->clock;
+
+    bool ok = false;
+    if (analyzed) {
+        ok = tanzanite_emit(c->tz, &warm->options);
+    } else {
+        for (size_t i = 0; i < warm->import_paths_count; i++)
+            interface_add_path(warm->import_paths[i]);
+        ok = tanzanite_compile(c->tz, &warm->options, req->input.str, req->input.size);
+        interface_reset();
+
+        /* the interfaces it imports can change while its source doesn't */
+        c->analyzed = ok && !tanzanite_imports(c->tz);
+        memcpy(c->key, key, sizeof(c->key));
+    }
+
+    const struct tanzanite_diagnostic *diagnostics = NULL;
+    size_t count = tanzanite_diagnostics(c->tz, &diagnostics);
+    for (size_t i = 0; i < count; i++)
+        diagnostic_print(stderr, diagnostics + i);
+    if (!ok)
+        return 1;
+
+    size_t size = 0;
+    const char *code = tanzanite_output(c->tz, &size);
+    fwrite(code, 1, size, stdout);
+    if (warm->interface != NULL && !tanzanite_write_interface(c->tz, warm->interface))
+        return 1;
+
+    *cacheable = !tanzanite_imports(c->tz) && warm->interface == NULL;
+    return 0;
+}
+
+/*
+ * Runs a request in the server's own process, fatal() unwinds out of a
+ * compile, with stdout, stderr and the working directory switched to the
+ * request's for the duration.
+ */
+static struct server_result _run_warm(struct server_state *state, struct server_request *req, struct server_warm *warm,
+    bool *cacheable)
+{
+    struct server_result res = { .status = 1 };
+    FILE *out = tmpfile();
+    FILE *err = tmpfile();
+    int cwd = open(".", O_RDONLY | O_DIRECTORY);
+    int saved_out = dup(STDOUT_FILENO);
+    int saved_err = dup(STDERR_FILENO);
+
+    if (out == NULL || err == NULL || cwd < 0 || saved_out < 0 || saved_err < 0) {
+        fprintf(stderr, "unable to start a compile: %s\n", strerror(errno));
+        abort();
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    dup2(fileno(out), STDOUT_FILENO);
+    dup2(fileno(err), STDERR_FILENO);
+
+    *cacheable = false;
+    if (chdir(req->cwd.str) != 0)
+        fprintf(stderr, "%s: %s\n", req->cwd.str, strerror(errno));
+    else
+        res.status = _compile_warm(state, req, warm, cacheable);
+
+    fflush(stdout);
+    fflush(stderr);
+    dup2(saved_out, STDOUT_FILENO);
+    dup2(saved_err, STDERR_FILENO);
+    close(saved_out);
+    close(saved_err);
+    if (fchdir(cwd) != 0)
+        abort();
+    close(cwd);
+
+    res.out = _slurp(out);
+    res.err = _slurp(err);
+    fclose(out);
+    fclose(err);
+    return res;
+}
+
+static void _free_results(struct result_store *results)
+{
+    for (uint32_t it = hash_begin(results); it < hash_end(results); it++) {
+        if (!hash_exists(results, it))
+            continue;
+        free((char *)hash_key(results, it));
+        str_free(&hash_value(results, it).out);
+        str_free(&hash_value(results, it).err);
+    }
+    result_store_free(results);
+}
+
+static void _handle(int fd, struct server_state *state)
+{
+    struct result_store *results = &state->results;
+    struct server_request req = {0};
+    if (!_read_request(fd, &req)) {
+        _free_request(&req);
+        return;
+    }
+
+    char key[CACHE_KEY_SIZE];
+    _request_key(&req, key);
+
+    struct server_result res = {0};
+    uint32_t it = result_store_find(results, key);
+    bool cached = hash_exists(results, it);
+    if (cached) {
+        res = hash_value(results, it);
+    } else {
+        bool cacheable = false;
+        struct server_warm warm = {0};
+        /* the server already ran getopt, start over for the request's arguments */
+        optind = 0;
+        if (state->options(req.argc, req.argv, &warm))
+            res = _run_warm(state, &req, &warm, &cacheable);
+        else
+            res = _run(&req, state->compile, &cacheable);
+        free(warm.import_paths);
+
+        if (cacheable && res.status == 0) {
+            if (results->len >= SERVER_RESULTS_MAX)
+                _free_results(results);
+            it = result_store_insert(results, strdup(key));
+            hash_value(results, it) = res;
+            cached = true;
+        }
+    }
+
+    int32_t status = res.status;
+    if (_write_all(fd, &status, sizeof(status)) && _write_str(fd, res.out))
+        _write_str(fd, res.err);
+
+    if (!cached) {
+        str_free(&res.out);
+        str_free(&res.err);
+    }
+    _free_request(&req);
+}
+
+static bool _address(const char *path, struct sockaddr_un *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "socket path %s is too long!\n", path);
+        return false;
+    }
+
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+int server_run(const char *path, server_compile compile, server_options options)
+{
+    struct sockaddr_un addr;
+    if (!_address(path, &addr))
+        return 1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    /* a socket left behind by a server that was killed */
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        fprintf(stderr, "unable to listen on %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    /* clients that go away mid answer must not take the server with them */
+    signal(SIGPIPE, SIG_IGN);
+
+    struct server_state state = { .compile = compile, .options = options };
+    for (;;) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "unable to accept on %s: %s\n", path, strerror(errno));
+            break;
+        }
+
+        _handle(client, &state);
+        close(client);
+    }
+
+    _free_results(&state.results);
+    for (size_t i = 0; i < SERVER_CONTEXTS; i++)
+        tanzanite_free(state.contexts[i].tz);
+    close(fd);
+    unlink(path);
+    return 1;
+}
+
+int server_forward(const char *path, int argc, char **argv)
+{
+    struct sockaddr_un addr;
+    if (!_address(path, &addr))
+        return 1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "unable to connect to %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    char *cwd = getcwd(NULL, 0);
+    struct str input = str_read(stdin);
+    uint32_t protocol = SERVER_PROTOCOL;
+    uint32_t count = argc;
+
+    bool sent = cwd != NULL
+        && _write_all(fd, &protocol, sizeof(protocol))
+        && _write_str(fd, _cstr(cwd))
+        && _write_str(fd, _cstr(getenv("TANZANITE_CACHE_DIR")))
+        && _write_all(fd, &count, sizeof(count));
+    for (int i = 0; sent && i < argc; i++)
+        sent = _write_str(fd, _cstr(argv[i]));
+    sent = sent && _write_str(fd, input);
+    free(cwd);
+    str_free(&input);
+
+    int32_t status = 1;
+    struct str out = {0};
+    struct str err = {0};
+    bool answered = sent && _read_all(fd, &status, sizeof(status))
+        && _read_str(fd, &out, UINT64_MAX - 1) && _read_str(fd, &err, UINT64_MAX - 1);
+    close(fd);
+
+    if (!answered) {
+        fprintf(stderr, "no answer from the server at %s\n", path);
+        return 1;
+    }
+
+    fwrite(out.str, 1, out.size, stdout);
+    fwrite(err.str, 1, err.size, stderr);
+    str_free(&out);
+    str_free(&err);
+    return status;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <ast.h>
+#include <str.h>
+#include <str_builder.h>
+#include <codegen.h>
+#include <call_graph.h>
+#include <output.h>
+#include <shard.h>
+
+/* how much C a top-level statement turns into, functions are the only ones that get split */
+static size_t _weight(struct ast *stmt)
+{
+    if (stmt->type != ANALYZE_FN)
+        return 0;
+
+    struct ast *body = stmt->u.a_fn.body;
+    if (stmt->u.a_fn.declaration || body == NULL || body->type == LAZY_BODY)
+        return 0;
+    return 1 + count_nodes(body);
+}
+
+/* internal functions are only called from their own unit and are declared static there */
+static struct str _header(struct ast *program, const char *prefix, struct call_graph *g, size_t *order, bool *internal)
+{
+    struct str_builder guard = {0};
+    const char *base = strrchr(prefix, '/');
+    str_builder_append_cstr(&guard, "__");
+    for (const char *c = base != NULL ? base + 1 : prefix; *c != '\0'; c++)
+        str_builder_append_char(&guard, isalnum((unsigned char)*c) ? toupper((unsigned char)*c) : '_');
+    str_builder_append_cstr(&guard, "_H__");
+    struct str name = str_builder_str(&guard);
+
+    struct str_builder b = {0};
+    str_builder_printf(&b, "#ifndef %s\n#define %s\n\n", name.str, name.str);
+    for (struct ast *iter = program->u.program; iter != NULL; iter = iter->u.statement.next) {
+        struct ast *stmt = iter->u.statement.current;
+        if (stmt->type == ANALYZE_FN && call_graph_find(g, stmt->u.a_fn.name.str) < g->count)
+            continue;
+
+        struct str decl = emit_c_declaration(stmt);
+        if (decl.str != NULL)
+            str_builder_append_str(&b, decl);
+        str_free(&decl);
+    }
+    for (size_t i = 0; i < g->count; i++) {
+        if (internal[order[i]])
+            continue;
+
+        struct str decl = emit_c_prototype(&g->nodes[order[i]].fn->u.a_fn, false);
+        str_builder_append_str(&b, decl);
+        str_free(&decl);
+    }
+    str_builder_append_cstr(&b, "\n#endif\n");
+
+    str_free(&name);
+    return str_builder_str(&b);
+}
+
+bool emit_shards(struct ast *program, unsigned count, const char *prefix)
+{
+    const char *base = strrchr(prefix, '/');
+    base = base != NULL ? base + 1 : prefix;
+
+    struct call_graph g;
+    call_graph_build(&g, program);
+    size_t *order = call_graph_order(&g);
+    unsigned *unit = calloc(g.count, sizeof(*unit));
+    bool *internal = calloc(g.count, sizeof(*internal));
+
+    size_t total = 0;
+    for (struct ast *iter = program->u.program; iter != NULL; iter = iter->u.statement.next)
+        total += _weight(iter->u.statement.current);
+
+    /* a function goes to the unit its midpoint falls in */
+    size_t before = 0;
+    for (struct ast *iter = program->u.program; iter != NULL; iter = iter->u.statement.next) {
+        struct ast *stmt = iter->u.statement.current;
+        size_t weight = _weight(stmt);
+        if (weight == 0)
+            continue;
+
+        size_t shard = total > 0 ? (before + weight / 2) * count / total : 0;
+        before += weight;
+        unit[call_graph_find(&g, stmt->u.a_fn.name.str)] = shard < count ? shard : count - 1;
+    }
+
+    for (size_t i = 0; i < g.count; i++) {
+        internal[i] = !g.nodes[i].fn->u.a_fn.exported;
+        for (size_t j = 0; j < g.nodes[i].callers_count; j++)
+            internal[i] = internal[i] && unit[g.nodes[i].callers[j]] == unit[i];
+    }
+
+    struct str_builder *shards = calloc(count, sizeof(*shards));
+    bool *declared = calloc(count, sizeof(*declared));
+    for (unsigned i = 0; i < count; i++)
+        str_builder_printf(shards + i, "#include \"%s.h\"\n\n", base);
+    for (size_t i = 0; i < g.count; i++) {
+        if (!internal[order[i]])
+            continue;
+
+        struct str decl = emit_c_prototype(&g.nodes[order[i]].fn->u.a_fn, true);
+        str_builder_append_str(shards + unit[order[i]], decl);
+        str_free(&decl);
+        declared[unit[order[i]]] = true;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        if (declared[i])
+            str_builder_append_char(shards + i, '\n');
+    }
+
+    /* globals are defined in the first unit */
+    for (struct ast *iter = program->u.program; iter != NULL; iter = iter->u.statement.next) {
+        struct ast *stmt = iter->u.statement.current;
+        size_t fn = stmt->type == ANALYZE_FN ? call_graph_find(&g, stmt->u.a_fn.name.str) : g.count;
+        if (stmt->type != ANALYZE_VAR && (fn == g.count || stmt->u.a_fn.declaration))
+            continue;
+
+        struct str code = emit_c_statement(stmt);
+        str_builder_append_str(shards + (fn < g.count ? unit[fn] : 0), code);
+        str_free(&code);
+    }
+
+    /* nothing is written before all of it was generated */
+    struct str_builder path = {0};
+    struct str header = _header(program, prefix, &g, order, internal);
+    str_builder_printf(&path, "%s.h", prefix);
+    struct str header_path = str_builder_str(&path);
+    bool written = output_write(header_path.str, header);
+    str_free(&header_path);
+    str_free(&header);
+
+    for (unsigned i = 0; i < count; i++) {
+        struct str code = str_builder_str(shards + i);
+        str_builder_printf(&path, "%s-%u.c", prefix, i);
+        struct str shard_path = str_builder_str(&path);
+        written = output_write(shard_path.str, code) && written;
+        str_free(&shard_path);
+        str_free(&code);
+    }
+
+    free(declared);
+    free(shards);
+    free(internal);
+    free(unit);
+    free(order);
+    call_graph_free(&g);
+    return written;
+}
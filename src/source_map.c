@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <str.h>
+#include <str_builder.h>
+#include <output.h>
+#include <codegen.h>
+#include <source_map.h>
+
+/* the sources named so far, a mapping refers to one by its index */
+struct sources {
+    struct str *names;
+    size_t count;
+};
+
+static long _source_index(struct sources *s, struct str name)
+{
+    for (size_t i = 0; i < s->count; i++) {
+        if (s->names[i].size == name.size && memcmp(s->names[i].str, name.str, name.size) == 0)
+            return i;
+    }
+
+    s->names = realloc(s->names, (s->count + 1) * sizeof(*s->names));
+    s->names[s->count] = str_init(name.str, name.size);
+    return s->count++;
+}
+
+/* the number and unescaped file of a #line directive, false for any other line */
+static bool _directive(struct str line, long *number, struct str_builder *file)
+{
+    static const char prefix[] = "#line ";
+    const char *end = line.str + line.size;
+
+    if (line.size < sizeof(prefix) - 1 || memcmp(line.str, prefix, sizeof(prefix) - 1) != 0)
+        return false;
+
+    char *it = NULL;
+    *number = strtol(line.str + sizeof(prefix) - 1, &it, 10);
+    while (it < end && *it == ' ')
+        it++;
+    if (it == end || *it != '"')
+        return true;
+
+    for (it++; it < end && *it != '"'; it++) {
+        if (*it == '\\' && it + 1 < end)
+            it++;
+        str_builder_append_char(file, *it);
+    }
+    return true;
+}
+
+static void _append_json_string(struct str_builder *b, struct str s)
+{
+    str_builder_append_char(b, '"');
+    for (uint64_t i = 0; i < s.size; i++) {
+        unsigned char c = s.str[i];
+        if (c == '"' || c == '\\')
+            str_builder_printf(b, "\\%c", c);
+        else if (c < 0x20)
+            str_builder_printf(b, "\\u%04x", c);
+        else
+            str_builder_append_char(b, c);
+    }
+    str_builder_append_char(b, '"');
+}
+
+bool source_map_write(const char *path, struct str *code, bool keep, const char *generated)
+{
+    struct sources sources = {0};
+    struct str_builder kept = {0};
+    struct str_builder mappings = {0};
+    /* where the next line of C came from, no source until a directive names one */
+    long source = -1;
+    long line = 0;
+    uint64_t c_line = 1;
+
+    for (uint64_t i = 0; i < code->size;) {
+        const char *start = code->str + i;
+        const char *newline = memchr(start, '\n', code->size - i);
+        struct str current = { (char *)start, newline != NULL ? (uint64_t)(newline - start) + 1 : code->size - i };
+        i += current.size;
+
+        long number = 0;
+        struct str_builder file = {0};
+        if (_directive(current, &number, &file)) {
+            /* a directive without a file stays in the one before, the runtimes have no source */
+            if (file.buffer.str != NULL)
+                source = strcmp(file.buffer.str, CODEGEN_RUNTIME_NAME) == 0 ? -1 : _source_index(&sources, file.buffer);
+            line = number;
+            str_builder_deinit(&file);
+            if (!keep)
+                continue;
+        } else if (source >= 0) {
+            if (current.str[0] != '\n')
+                str_builder_printf(&mappings, "%s[%lu, %ld, %ld]", mappings.buffer.size > 0 ? ", " : "",
+                    (unsigned long)c_line, source, line);
+            line++;
+        }
+
+        if (!keep)
+            str_builder_append_str(&kept, current);
+        c_line++;
+    }
+
+    struct str_builder b = {0};
+    str_builder_append_cstr(&b, "{\"version\": 1, ");
+    if (generated != NULL) {
+        str_builder_append_cstr(&b, "\"file\": ");
+        _append_json_string(&b, (struct str){ (char *)generated, strlen(generated) });
+        str_builder_append_cstr(&b, ", ");
+    }
+    str_builder_append_cstr(&b, "\"sources\": [");
+    for (size_t i = 0; i < sources.count; i++) {
+        if (i > 0)
+            str_builder_append_cstr(&b, ", ");
+        _append_json_string(&b, sources.names[i]);
+        str_free(sources.names + i);
+    }
+    str_builder_append_cstr(&b, "], \"mappings\": [");
+    if (mappings.buffer.str != NULL)
+        str_builder_append_str(&b, mappings.buffer);
+    str_builder_append_cstr(&b, "]}\n");
+    str_builder_deinit(&mappings);
+    free(sources.names);
+
+    if (!keep) {
+        str_free(code);
+        *code = kept.buffer.str != NULL ? str_builder_str(&kept) : str_init("", 0);
+    }
+
+    struct str content = str_builder_str(&b);
+    bool written = output_write(path, content);
+    str_free(&content);
+    return written;
+}
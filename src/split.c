@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <ast.h>
+#include <split.h>
+#include <diagnostic.h>
+
+struct chunk {
+    struct source_range range;
+    struct ast *program;
+    pthread_t thread;
+};
+
+/* same characters the lexer puts in identifiers */
+static bool _word_char(char c)
+{
+    return (c >= 'A' && c <= 'z') || (c >= '0' && c <= '9');
+}
+
+static bool _at_definition(const char *source, uint64_t size, uint64_t i)
+{
+    /* annotations belong to the definition after them, the cut goes before them */
+    if (source[i] == '@')
+        return true;
+
+    if (i > 0 && _word_char(source[i - 1]))
+        return false;
+    if (i + 3 > size)
+        return false;
+    if (memcmp(source + i, "def", 3) != 0 && memcmp(source + i, "fun", 3) != 0)
+        return false;
+    if (i + 3 < size && _word_char(source[i + 3]))
+        return false;
+
+    uint64_t before = i;
+    while (before > 0 && (source[before - 1] == ' ' || source[before - 1] == '\t' || source[before - 1] == '\r'
+            || source[before - 1] == '\n'))
+        before--;
+    return before == 0 || source[before - 1] != ']';
+}
+
+/*
+ * functions can't be defined inside each other, so outside of string and char
+ * literals every def or fun, or the annotations before one, starts a
+ * top-level definition and is a safe cut
+ */
+static uint32_t _find_chunks(const char *source, uint64_t size, unsigned jobs, struct chunk *chunks)
+{
+    uint32_t count = 0;
+    uint64_t start = 0;
+    int start_line = 1;
+    int line = 1;
+    uint64_t target = size / jobs;
+
+    for (uint64_t i = 0; i < size; i++) {
+        switch (source[i]) {
+        case '\n':
+            line++;
+            break;
+        case '"':
+            for (i++; i < size && source[i] != '"'; i++) {
+                if (source[i] == '\\' && i + 1 < size)
+                    i++;
+                if (source[i] == '\n')
+                    line++;
+            }
+            break;
+        case '\'': {
+            /* the lexer's char literal runs to the last quote on the line */
+            uint64_t end = i;
+            for (uint64_t j = i + 1; j < size && source[j] != '\n'; j++) {
+                if (source[j] == '\'')
+                    end = j;
+            }
+            i = end;
+            break;
+        }
+        default:
+            if (i < target || i == start || !_at_definition(source, size, i))
+                break;
+
+            chunks[count++] = (struct chunk){ .range = { start, i - start, start_line } };
+            start = i;
+            start_line = line;
+            target = count + 1 < jobs ? start + (size - start) / (jobs - count) : UINT64_MAX;
+            break;
+        }
+    }
+
+    chunks[count++] = (struct chunk){ .range = { start, size - start, start_line } };
+    return count;
+}
+
+static void *_parse_chunk(void *arg)
+{
+    struct chunk *chunk = arg;
+    chunk->program = parse_chunk(chunk->range);
+    return NULL;
+}
+
+struct ast *parse_split(const char *source, uint64_t size, unsigned jobs)
+{
+    struct chunk *chunks = calloc(jobs, sizeof(*chunks));
+    uint32_t count = _find_chunks(source, size, jobs, chunks);
+
+    for (uint32_t i = 1; i < count; i++) {
+        if (pthread_create(&chunks[i].thread, NULL, _parse_chunk, chunks + i) != 0) {
+            fatal("could not start a parser thread!");
+        }
+    }
+    _parse_chunk(chunks);
+    for (uint32_t i = 1; i < count; i++)
+        pthread_join(chunks[i].thread, NULL);
+
+    /* splice the statement lists together in source order */
+    struct ast *program = NULL;
+    struct ast *tail = NULL;
+    bool failed = false;
+    for (uint32_t i = 0; i < count; i++) {
+        struct ast *chunk = chunks[i].program;
+        if (chunk == NULL) {
+            failed = true;
+            continue;
+        }
+
+        if (program == NULL) {
+            program = chunk;
+            tail = program->u.program;
+        } else {
+            if (tail == NULL)
+                program->u.program = chunk->u.program;
+            else
+                tail->u.statement.next = chunk->u.program;
+            tail = chunk->u.program != NULL ? chunk->u.program : tail;
+            free(chunk);
+        }
+
+        while (tail != NULL && tail->u.statement.next != NULL)
+            tail = tail->u.statement.next;
+    }
+
+    free(chunks);
+
+    if (failed) {
+        free_node(program);
+        return NULL;
+    }
+
+    return program;
+}
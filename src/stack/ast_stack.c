@@ -0,0 +1,7 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stack.h>
+
+#include <stack/ast_stack.h>
+
+STACK_IMPL(ast_stack, struct ast_frame);
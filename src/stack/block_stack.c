@@ -0,0 +1,7 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stack.h>
+
+#include <stack/block_stack.h>
+
+STACK_IMPL(block_stack, uint8_t);
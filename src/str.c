@@ -23,6 +23,26 @@ void str_free(struct str *str)
     str->size = 0;
 }
 
+/* reads everything left in the stream, the result is NUL terminated */
+struct str str_read(FILE *in)
+{
+    struct str s = {0};
+    uint64_t cap = 4096;
+    size_t read = 0;
+
+    s.str = malloc(cap);
+    while ((read = fread(s.str + s.size, 1, cap - s.size - 1, in)) > 0) {
+        s.size += read;
+        if (s.size + 1 == cap) {
+            cap *= 2;
+            s.str = realloc(s.str, cap);
+        }
+    }
+    s.str[s.size] = '\0';
+
+    return s;
+}
+
 
 static uint64_t getlen(const char *str, uint64_t len)
 {
@@ -0,0 +1,44 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ast.h>
+#include <str.h>
+#include <stream.h>
+#include <analyzer.h>
+#include <codegen.h>
+
+void compile_stream(struct analyzer_context *ctx, struct ast *program, FILE *out)
+{
+    prepare_globals(ctx, program);
+
+    struct ast *iter = program->u.program;
+    while (iter != NULL) {
+        struct ast *stmt = iter->u.statement.current;
+        struct analyzable_function *fn = NULL;
+
+        if (stmt->type == ANALYZE_FN && !stmt->u.a_fn.declaration) {
+            uint32_t it = function_store_find(&ctx->functions, stmt->u.a_fn.name.str);
+            fn = &hash_value(&ctx->functions, it);
+            prepare_function(ctx, fn->name.str);
+
+            /* calls only matter for reachability in prepare(), here every function is checked */
+            fn_call_queue_free(&ctx->call_queue);
+        }
+
+        struct str code = emit_c_statement(stmt);
+        if (code.str != NULL)
+            fwrite(code.str, 1, code.size, out);
+        str_free(&code);
+
+        if (fn != NULL) {
+            free_node(fn->body);
+            fn->body = NULL;
+            stmt->u.a_fn.body = NULL;
+        }
+
+        iter = iter->u.statement.next;
+    }
+
+    var_store_pop_frame(&ctx->variables);
+}
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#include <ast.h>
+#include <str.h>
+#include <lazy.h>
+#include <analyzer.h>
+#include <codegen.h>
+#include <interface.h>
+#include <diagnostic.h>
+#include <tanzanite.h>
+
+struct tanzanite {
+    struct analyzer_context ctx;
+    struct diagnostics diagnostics;
+
+    /* lazy bodies point into it until the next reset */
+    struct str source;
+    struct ast *program;
+    /* analysis finished, so every node is safe to free */
+    bool complete;
+    /* what a compilation that didn't finish left is freed through it */
+    struct ast_tracker nodes;
+
+    struct str output;
+};
+
+struct tanzanite *tanzanite_new(void)
+{
+    return calloc(1, sizeof(struct tanzanite));
+}
+
+void tanzanite_free(struct tanzanite *tz)
+{
+    if (tz == NULL)
+        return;
+
+    tanzanite_reset(tz);
+    free_context(&tz->ctx);
+    ast_tracker_free(&tz->nodes);
+    free(tz);
+}
+
+/* the stores are cleared in place, the next compilation reuses their room */
+void tanzanite_reset(struct tanzanite *tz)
+{
+    /* what is freed here comes off the tracker, the rest is all of a half analyzed tree, or what a finished one no longer points to */
+    ast_track(&tz->nodes);
+    clear_context(&tz->ctx, tz->complete);
+    if (tz->complete)
+        free_node(tz->program);
+    ast_track(NULL);
+    ast_tracker_clear(&tz->nodes);
+    tz->program = NULL;
+    tz->complete = false;
+
+    diagnostics_free(&tz->diagnostics);
+    str_free(&tz->output);
+    str_free(&tz->source);
+    parse_use_source((struct str){0});
+}
+
+/* the globals the options stand for, as they were before a call set them */
+struct globals {
+    bool lazy;
+    bool instrument;
+    bool trace;
+    bool bench;
+    const char *source_name;
+    struct profile *profile;
+};
+
+static struct globals _use_options(const struct tanzanite_options *options)
+{
+    struct globals saved = { lazy_bodies, codegen_instrument, codegen_trace, codegen_bench, codegen_source_name,
+        codegen_profile };
+
+    lazy_bodies = options->lazy;
+    codegen_instrument = options->instrument;
+    codegen_trace = options->trace;
+    codegen_bench = options->bench;
+    codegen_source_name = options->source_name;
+    codegen_profile = NULL;
+    return saved;
+}
+
+static void _restore(struct globals *saved)
+{
+    lazy_bodies = saved->lazy;
+    codegen_instrument = saved->instrument;
+    codegen_trace = saved->trace;
+    codegen_bench = saved->bench;
+    codegen_source_name = saved->source_name;
+    codegen_profile = saved->profile;
+}
+
+static bool _compile(struct tanzanite *tz, const struct tanzanite_options *options)
+{
+    jmp_buf unwind;
+    tz->diagnostics.unwind = &unwind;
+    if (setjmp(unwind) != 0)
+        return false;
+
+    tz->ctx.module = options->module;
+    tz->ctx.bench = options->bench;
+
+    /* parse errors were already reported */
+    if ((tz->program = parse_buffer(tz->source, 1)) == NULL)
+        return false;
+
+    prepare(&tz->ctx, tz->program);
+    tz->output = emit_c(tz->program);
+    tz->complete = true;
+    return true;
+}
+
+static bool _emit(struct tanzanite *tz)
+{
+    jmp_buf unwind;
+    tz->diagnostics.unwind = &unwind;
+    if (setjmp(unwind) != 0)
+        return false;
+
+    tz->output = emit_c(tz->program);
+    return true;
+}
+
+bool tanzanite_compile(struct tanzanite *tz, const struct tanzanite_options *options, const char *source, size_t size)
+{
+    static const struct tanzanite_options defaults = {0};
+
+    tanzanite_reset(tz);
+
+    tz->source.str = malloc(size + 1);
+    tz->source.size = size;
+    memcpy(tz->source.str, source, size);
+    tz->source.str[size] = '\0';
+
+    struct globals saved = _use_options(options != NULL ? options : &defaults);
+    diagnostics_capture(&tz->diagnostics);
+    ast_track(&tz->nodes);
+    bool ok = _compile(tz, options != NULL ? options : &defaults);
+    ast_track(NULL);
+    diagnostics_capture(NULL);
+    tz->diagnostics.unwind = NULL;
+    _restore(&saved);
+
+    return ok;
+}
+
+bool tanzanite_emit(struct tanzanite *tz, const struct tanzanite_options *options)
+{
+    static const struct tanzanite_options defaults = {0};
+
+    if (!tz->complete)
+        return false;
+
+    str_free(&tz->output);
+    diagnostics_free(&tz->diagnostics);
+
+    struct globals saved = _use_options(options != NULL ? options : &defaults);
+    diagnostics_capture(&tz->diagnostics);
+    bool ok = _emit(tz);
+    diagnostics_capture(NULL);
+    tz->diagnostics.unwind = NULL;
+    _restore(&saved);
+
+    return ok;
+}
+
+bool tanzanite_imports(struct tanzanite *tz)
+{
+    return tz->complete && program_imports(tz->program);
+}
+
+bool tanzanite_write_interface(struct tanzanite *tz, const char *path)
+{
+    return tz->complete && interface_write(&tz->ctx, tz->program, path);
+}
+
+const char *tanzanite_output(struct tanzanite *tz, size_t *size)
+{
+    if (size != NULL)
+        *size = tz->output.size;
+    return tz->output.str;
+}
+
+size_t tanzanite_diagnostics(struct tanzanite *tz, const struct tanzanite_diagnostic **diagnostics)
+{
+    *diagnostics = tz->diagnostics.items;
+    return tz->diagnostics.count;
+}
@@ -0,0 +1,143 @@
+#include <trace.h>
+
+/*
+ * libc is reached under names of its own, the program may declare these
+ * differently or not at all. Without time.h the clock and the signal are
+ * the numbers of the systems the generated C is built on.
+ */
+const char trace_runtime[] =
+    "#define tz_trace_str2(x) #x\n"
+    "#define tz_trace_str(x) tz_trace_str2(x)\n"
+    "#define tz_trace_symbol(name) __asm__(tz_trace_str(__USER_LABEL_PREFIX__) name)\n"
+    "#if defined(__APPLE__)\n"
+    "#define TZ_TRACE_CLOCK 6\n"
+    "#define TZ_TRACE_SIGNAL 30\n"
+    "#elif defined(__FreeBSD__)\n"
+    "#define TZ_TRACE_CLOCK 4\n"
+    "#define TZ_TRACE_SIGNAL 30\n"
+    "#else\n"
+    "#define TZ_TRACE_CLOCK 1\n"
+    "#define TZ_TRACE_SIGNAL 10\n"
+    "#endif\n"
+    "#define TZ_TRACE_EVENTS 65536\n"
+    "struct tz_trace_time {\n"
+    "long sec;\n"
+    "long nsec;\n"
+    "};\n"
+    "extern int tz_trace_clock_gettime(int, struct tz_trace_time *) tz_trace_symbol(\"clock_gettime\");\n"
+    "extern void *tz_trace_calloc(unsigned long, unsigned long) tz_trace_symbol(\"calloc\");\n"
+    "extern char *tz_trace_getenv(const char *) tz_trace_symbol(\"getenv\");\n"
+    "extern void *tz_trace_signal(int, void (*)(int)) tz_trace_symbol(\"signal\");\n"
+    "extern int tz_trace_getpid(void) tz_trace_symbol(\"getpid\");\n"
+    "extern void *tz_trace_fopen(const char *, const char *) tz_trace_symbol(\"fopen\");\n"
+    "extern int tz_trace_fprintf(void *, const char *, ...) tz_trace_symbol(\"fprintf\");\n"
+    "extern int tz_trace_fclose(void *) tz_trace_symbol(\"fclose\");\n"
+    "\n"
+    "struct tz_trace_event {\n"
+    "u64 ns;\n"
+    "u32 fn;\n"
+    "u32 end;\n"
+    "};\n"
+    "\n"
+    "/* written by its own thread only, the dump reads up to head */\n"
+    "struct tz_trace_ring {\n"
+    "struct tz_trace_ring *next;\n"
+    "u64 thread;\n"
+    "u64 head;\n"
+    "struct tz_trace_event events[TZ_TRACE_EVENTS];\n"
+    "};\n"
+    "\n"
+    "static int tz_trace_enabled;\n"
+    "static volatile int tz_trace_dump_requested;\n"
+    "static const char *tz_trace_path;\n"
+    "static u64 tz_trace_epoch;\n"
+    "static u64 tz_trace_threads;\n"
+    "static struct tz_trace_ring *tz_trace_rings;\n"
+    "static __thread struct tz_trace_ring *tz_trace_ring;\n"
+    "\n"
+    "static void tz_trace_dump(void);\n"
+    "\n"
+    "static u64 tz_trace_now(void)\n"
+    "{\n"
+    "struct tz_trace_time t;\n"
+    "tz_trace_clock_gettime(TZ_TRACE_CLOCK, &t);\n"
+    "return (u64)t.sec * 1000000000ull + (u64)t.nsec;\n"
+    "}\n"
+    "\n"
+    "static struct tz_trace_ring *tz_trace_new_ring(void)\n"
+    "{\n"
+    "struct tz_trace_ring *r = tz_trace_calloc(1, sizeof(*r));\n"
+    "if (r == 0)\n"
+    "return 0;\n"
+    "r->thread = __atomic_add_fetch(&tz_trace_threads, 1, __ATOMIC_RELAXED);\n"
+    "r->next = __atomic_load_n(&tz_trace_rings, __ATOMIC_RELAXED);\n"
+    "while (!__atomic_compare_exchange_n(&tz_trace_rings, &r->next, r, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))\n"
+    ";\n"
+    "return r;\n"
+    "}\n"
+    "\n"
+    "__attribute__((noinline)) static void tz_trace_record(u32 fn, u32 end)\n"
+    "{\n"
+    "struct tz_trace_ring *r = tz_trace_ring;\n"
+    "if (r == 0 && (r = tz_trace_ring = tz_trace_new_ring()) == 0)\n"
+    "return;\n"
+    "u64 head = r->head;\n"
+    "struct tz_trace_event *e = &r->events[head % TZ_TRACE_EVENTS];\n"
+    "e->ns = tz_trace_now();\n"
+    "e->fn = fn;\n"
+    "e->end = end;\n"
+    "__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);\n"
+    "if (__builtin_expect(tz_trace_dump_requested, 0)) {\n"
+    "tz_trace_dump_requested = 0;\n"
+    "tz_trace_dump();\n"
+    "}\n"
+    "}\n";
+
+const char trace_writer[] =
+    "static void tz_trace_on_signal(int sig)\n"
+    "{\n"
+    "(void)sig;\n"
+    "tz_trace_dump_requested = 1;\n"
+    "}\n"
+    "\n"
+    "/* the events still in every ring, as Chrome's trace event format */\n"
+    "static void tz_trace_dump(void)\n"
+    "{\n"
+    "void *f = tz_trace_fopen(tz_trace_path, \"w\");\n"
+    "if (f == 0)\n"
+    "return;\n"
+    "int pid = tz_trace_getpid();\n"
+    "const char *separator = \"\\n\";\n"
+    "tz_trace_fprintf(f, \"{\\\"traceEvents\\\":[\");\n"
+    "for (struct tz_trace_ring *r = __atomic_load_n(&tz_trace_rings, __ATOMIC_ACQUIRE); r != 0; r = r->next) {\n"
+    "u64 head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);\n"
+    "for (u64 i = head > TZ_TRACE_EVENTS ? head - TZ_TRACE_EVENTS : 0; i < head; i++) {\n"
+    "struct tz_trace_event *e = &r->events[i % TZ_TRACE_EVENTS];\n"
+    "u64 ns = e->ns > tz_trace_epoch ? e->ns - tz_trace_epoch : 0;\n"
+    "tz_trace_fprintf(f, \"%s{\\\"name\\\":\\\"%s\\\",\\\"ph\\\":\\\"%s\\\",\\\"ts\\\":%llu.%03llu,\\\"pid\\\":%d,\\\"tid\\\":%llu}\", separator,\n"
+    "tz_trace_names[e->fn], e->end ? \"E\" : \"B\", (unsigned long long)(ns / 1000), (unsigned long long)(ns % 1000),\n"
+    "pid, (unsigned long long)r->thread);\n"
+    "separator = \",\\n\";\n"
+    "}\n"
+    "}\n"
+    "tz_trace_fprintf(f, \"\\n],\\\"displayTimeUnit\\\":\\\"ns\\\"}\\n\");\n"
+    "tz_trace_fclose(f);\n"
+    "}\n"
+    "\n"
+    "__attribute__((constructor)) static void tz_trace_start(void)\n"
+    "{\n"
+    "tz_trace_path = tz_trace_getenv(\"TANZANITE_TRACE\");\n"
+    "if (tz_trace_path == 0 || *tz_trace_path == 0)\n"
+    "return;\n"
+    "tz_trace_epoch = tz_trace_now();\n"
+    "tz_trace_signal(TZ_TRACE_SIGNAL, tz_trace_on_signal);\n"
+    "tz_trace_enabled = 1;\n"
+    "}\n"
+    "\n"
+    "__attribute__((destructor)) static void tz_trace_stop(void)\n"
+    "{\n"
+    "if (!tz_trace_enabled)\n"
+    "return;\n"
+    "tz_trace_enabled = 0;\n"
+    "tz_trace_dump();\n"
+    "}\n";
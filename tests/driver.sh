@@ -0,0 +1,34 @@
+#!/bin/sh
+# -o builds a program using until and unless, and it runs.
+#
+# usage: tests/driver.sh [path/to/Tanzanite]
+
+set -e
+
+TANZANITE=${1:-${TANZANITE:-./Tanzanite}}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+cat > "$WORK/prog.tzn" <<'EOF'
+fun printf(fmt: *u8, ...): i32 end
+
+n: i64 = 0;
+
+def main(): i32
+    until n >= 3 do
+        n += 1;
+    end
+    unless n < 3 then
+        printf("%ld\n", n);
+    end
+end
+EOF
+
+"$TANZANITE" -o "$WORK/prog" < "$WORK/prog.tzn"
+
+out=$("$WORK/prog")
+if [ "$out" != "3" ]; then
+    echo "driver.sh: expected 3, the program printed '$out'" >&2
+    exit 1
+fi
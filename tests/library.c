@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <tanzanite.h>
+
+/*
+ * Compilations one after another in the same context, what a failed one
+ * leaves behind must not change the next.
+ */
+
+/* a for loop without a payload */
+static const char failing[] =
+    "def main(): i32\n"
+    "    for 1..10 do\n"
+    "        1;\n"
+    "    end\n"
+    "end\n";
+
+static const char working[] =
+    "def main(): i32\n"
+    "    1;\n"
+    "end\n";
+
+static const char benched[] =
+    "bench \"one\" do\n"
+    "    1;\n"
+    "end\n";
+
+static int failures;
+
+static void _check(bool ok, const char *what)
+{
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static bool _compile(struct tanzanite *tz, const struct tanzanite_options *options, const char *source)
+{
+    return tanzanite_compile(tz, options, source, strlen(source));
+}
+
+static bool _output_has(struct tanzanite *tz, const char *needle)
+{
+    size_t size = 0;
+    const char *c = tanzanite_output(tz, &size);
+    return c != NULL && strstr(c, needle) != NULL;
+}
+
+static void _failed_traced_then_plain(struct tanzanite *tz)
+{
+    struct tanzanite_options traced = { .trace = true };
+
+    _check(!_compile(tz, &traced, failing), "traced compile of a bad loop fails");
+    _check(_compile(tz, NULL, working), "plain compile after a failed traced one");
+    _check(!_output_has(tz, "tz_trace"), "plain compile after a failed traced one isn't traced");
+}
+
+static void _failed_bench_then_plain(struct tanzanite *tz)
+{
+    struct tanzanite_options bench = { .bench = true };
+
+    _check(!_compile(tz, &bench, failing), "bench compile of a bad loop fails");
+    _check(_compile(tz, NULL, working), "plain compile after a failed bench one");
+    _check(!_output_has(tz, "tz_bench"), "plain compile after a failed bench one has no harness");
+    _check(_compile(tz, &bench, benched), "bench compile after a failed bench one");
+    _check(_output_has(tz, "{\"one\", tz_bench_0}"), "bench compile after a failed bench one lists its bench");
+}
+
+int main(void)
+{
+    struct tanzanite *tz = tanzanite_new();
+
+    _failed_traced_then_plain(tz);
+    _failed_bench_then_plain(tz);
+
+    tanzanite_free(tz);
+    return failures > 0;
+}
@@ -0,0 +1,30 @@
+#!/bin/sh
+# A program read from stdin maps its C back to "<stdin>".
+#
+# usage: tests/source_map.sh [path/to/Tanzanite]
+
+set -e
+
+TANZANITE=${1:-${TANZANITE:-./Tanzanite}}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+cat > "$WORK/prog.tzn" <<'EOF'
+def main(): i32
+    1;
+end
+EOF
+
+"$TANZANITE" --source-map "$WORK/prog.map" < "$WORK/prog.tzn" > "$WORK/prog.c"
+
+if ! grep -q '"sources": \["<stdin>"\]' "$WORK/prog.map"; then
+    echo "source_map.sh: <stdin> is not a source" >&2
+    cat "$WORK/prog.map" >&2
+    exit 1
+fi
+if grep -q '"mappings": \[\]' "$WORK/prog.map"; then
+    echo "source_map.sh: nothing is mapped" >&2
+    cat "$WORK/prog.map" >&2
+    exit 1
+fi